@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "aggregate.h"
+
+/**
+ * @brief Creates an empty accumulator.
+ *
+ * @return AGGREGATE* The accumulator (release it with `free`), or NULL if memory allocation fails.
+ */
+AGGREGATE *createAggregate(void) {
+    AGGREGATE *agg = (AGGREGATE *)calloc(1, sizeof(AGGREGATE));
+    if (agg != NULL) {
+        agg->protonMin = LLONG_MAX;
+    }
+    return agg;
+}
+
+/**
+ * @brief Adds `value` to a total, stopping at LLONG_MAX if it does not fit.
+ */
+static void addTotal(long long *total, long long value, unsigned char *overflow) {
+    if (__builtin_add_overflow(*total, value, total)) {
+        *total = LLONG_MAX;
+        *overflow = 1;
+    }
+}
+
+/**
+ * @brief Keeps a formula among the largest ones if it has enough atoms.
+ *
+ * The formulas are ordered by atoms and then by line, so the result does not
+ * depend on how the input was split between the threads.
+ */
+static void keepLargest(AGGREGATE *agg, const BIGFORMULA *f) {
+    int k = agg->top;
+    while (k > 0 && (agg->largest[k - 1].atoms < f->atoms ||
+                     (agg->largest[k - 1].atoms == f->atoms && agg->largest[k - 1].line > f->line))) {
+        k--;
+    }
+    if (k == TOP_FORMULAS) {
+        return; // Smaller than all of them
+    }
+    int last = (agg->top < TOP_FORMULAS) ? agg->top : TOP_FORMULAS - 1;
+    memmove(&agg->largest[k + 1], &agg->largest[k], (last - k) * sizeof(BIGFORMULA));
+    agg->largest[k] = *f;
+    if (agg->top < TOP_FORMULAS) {
+        agg->top++;
+    }
+}
+
+/**
+ * @brief Records a proton total in the minimum, maximum, mean and histogram.
+ */
+static void addProtons(AGGREGATE *agg, long long protons) {
+    int bucket = (protons == 0) ? 0 : 64 - __builtin_clzll((unsigned long long)protons);
+    agg->histogram[bucket]++;
+    agg->protonMin = (protons < agg->protonMin) ? protons : agg->protonMin;
+    agg->protonMax = (protons > agg->protonMax) ? protons : agg->protonMax;
+}
+
+/**
+ * @brief Adds the element counts of a formula to the totals.
+ *
+ * @param agg The accumulator.
+ * @param counts The number of atoms of each element of the formula (from `countChem`).
+ * @param pert Pointer to the periodic table.
+ * @param chem The formula, kept if it is among the largest ones.
+ * @param length The length of the formula.
+ * @param line The line number of the formula.
+ */
+void addFormula(AGGREGATE *agg, const long long counts[N], const PTABLE * const pert, const char *chem, int length, int line) {
+    long long atoms = 0, protons = 0, term;
+    unsigned char atomsOverflow = 0;
+    int protonsFit = 1;
+
+    for (int k = 0; k < N; k++) {
+        if (counts[k] == 0) {
+            continue;
+        }
+        addTotal(&agg->elements[k], counts[k], &agg->overflow[k]);
+        addTotal(&atoms, counts[k], &atomsOverflow); // Counts that fit in 64 bits may not add up in 64 bits
+        if (__builtin_mul_overflow(counts[k], (long long)pert->anum[k], &term) ||
+            __builtin_add_overflow(protons, term, &protons)) {
+            protonsFit = 0;
+        }
+    }
+
+    agg->formulas++;
+    unsigned char overflow = (unsigned char)agg->atomsOverflow;
+    addTotal(&agg->atoms, atoms, &overflow);
+    agg->atomsOverflow = overflow || atomsOverflow;
+    if (protonsFit) {
+        addProtons(agg, protons);
+        agg->protonSum += (double)protons;
+        agg->protonCount++;
+    }
+
+    // Only formulas that can enter the list are copied
+    if (agg->top < TOP_FORMULAS || atoms > agg->largest[TOP_FORMULAS - 1].atoms) {
+        BIGFORMULA f;
+        f.atoms = atoms;
+        f.line = line;
+        f.len = length;
+        int n = (length < TOP_TEXT) ? length : TOP_TEXT;
+        memcpy(f.text, chem, n);
+        f.text[n] = '\0';
+        keepLargest(agg, &f);
+    }
+}
+
+/**
+ * @brief Adds the totals of one accumulator (of a worker thread) to another.
+ */
+void mergeAggregate(AGGREGATE *into, const AGGREGATE *from) {
+    into->formulas += from->formulas;
+    into->failed += from->failed;
+    for (int k = 0; k < N; k++) {
+        addTotal(&into->elements[k], from->elements[k], &into->overflow[k]);
+        into->overflow[k] |= from->overflow[k];
+    }
+    unsigned char overflow = (unsigned char)(into->atomsOverflow || from->atomsOverflow);
+    addTotal(&into->atoms, from->atoms, &overflow);
+    into->atomsOverflow = overflow;
+
+    into->protonMin = (from->protonMin < into->protonMin) ? from->protonMin : into->protonMin;
+    into->protonMax = (from->protonMax > into->protonMax) ? from->protonMax : into->protonMax;
+    into->protonSum += from->protonSum;
+    into->protonCount += from->protonCount;
+    for (int b = 0; b < PROTON_BUCKETS; b++) {
+        into->histogram[b] += from->histogram[b];
+    }
+    for (int t = 0; t < from->top; t++) {
+        keepLargest(into, &from->largest[t]);
+    }
+}
+
+/**
+ * @brief Writes a total, or `overflow` if it does not fit in 64 bits.
+ */
+static void writeTotal(WRITER *out, long long total, int overflow) {
+    if (overflow) {
+        writeString(out, "overflow");
+    } else {
+        writeInt(out, total);
+    }
+    writeChar(out, '\n');
+}
+
+/**
+ * @brief Writes the summary of the totals as key=value lines.
+ *
+ * The lines are: formulas, failed, atoms, atoms_<symbol> for every element that
+ * appears (in the order of the table), protons_min, protons_max and protons_mean,
+ * protons_overflow for the formulas whose proton number does not fit in 64 bits,
+ * protons_<from>-<to> for every non-empty range of the histogram, and
+ * largest_<rank> as `line atoms formula` (the formula cut after TOP_TEXT characters).
+ */
+void writeAggregate(WRITER *out, const AGGREGATE *agg, const PTABLE * const pert) {
+    writeString(out, "formulas=");
+    writeInt(out, agg->formulas);
+    writeString(out, "\nfailed=");
+    writeInt(out, agg->failed);
+    writeString(out, "\natoms=");
+    writeTotal(out, agg->atoms, agg->atomsOverflow);
+
+    for (int k = 0; k < N; k++) {
+        if (agg->elements[k] != 0 || agg->overflow[k]) {
+            writeString(out, "atoms_");
+            writeString(out, pert->ch[k]);
+            writeChar(out, '=');
+            writeTotal(out, agg->elements[k], agg->overflow[k]);
+        }
+    }
+
+    if (agg->protonCount > 0) {
+        writeString(out, "protons_min=");
+        writeInt(out, agg->protonMin);
+        writeString(out, "\nprotons_max=");
+        writeInt(out, agg->protonMax);
+        writeString(out, "\nprotons_mean=");
+        writeFixed(out, agg->protonSum / agg->protonCount, 2);
+        writeChar(out, '\n');
+    }
+    if (agg->protonCount < agg->formulas) {
+        writeString(out, "protons_overflow="); // Left out of the proton lines
+        writeInt(out, agg->formulas - agg->protonCount);
+        writeChar(out, '\n');
+    }
+    for (int b = 0; b < PROTON_BUCKETS; b++) {
+        if (agg->histogram[b] == 0) {
+            continue;
+        }
+        unsigned long long from = (b == 0) ? 0 : 1ULL << (b - 1);
+        unsigned long long to = (b == 0) ? 0 : (b == 64) ? (unsigned long long)LLONG_MAX : (1ULL << b) - 1;
+        writeString(out, "protons_");
+        writeInt(out, (long long)from);
+        writeChar(out, '-');
+        writeInt(out, (long long)to);
+        writeChar(out, '=');
+        writeInt(out, agg->histogram[b]);
+        writeChar(out, '\n');
+    }
+
+    for (int t = 0; t < agg->top; t++) {
+        const BIGFORMULA *f = &agg->largest[t];
+        writeString(out, "largest_");
+        writeInt(out, t + 1);
+        writeChar(out, '=');
+        writeInt(out, f->line);
+        writeChar(out, ' ');
+        writeInt(out, f->atoms);
+        writeChar(out, ' ');
+        writeString(out, f->text);
+        if (f->len > TOP_TEXT) {
+            writeString(out, "...");
+        }
+        writeChar(out, '\n');
+    }
+}
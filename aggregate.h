@@ -0,0 +1,50 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "periodicTable.h" // Include the periodic table definition
+#include "writer.h"
+
+#define TOP_FORMULAS 10     ///< Number of largest formulas that are reported
+#define TOP_TEXT 64         ///< Characters of a largest formula that are kept
+#define PROTON_BUCKETS 65   ///< Buckets of the proton histogram: 0, then [2^(k-1), 2^k) for k = 1..64
+
+/**
+ * @brief One of the largest formulas of the input.
+ */
+typedef struct {
+    long long atoms;        ///< Atoms of the formula
+    int line;               ///< Line of the formula
+    int len;                ///< Length of the formula (`text` may hold only its beginning)
+    char text[TOP_TEXT + 1]; ///< The beginning of the formula, null-terminated
+} BIGFORMULA;
+
+/**
+ * @brief Totals over the formulas of an input file.
+ *
+ * Every worker thread adds its formulas to its own accumulator, indexed by the
+ * slots of the periodic table, and the accumulators are merged at the end. A total
+ * that does not fit in 64 bits stops at LLONG_MAX and is reported as an overflow.
+ */
+typedef struct {
+    long formulas;          ///< Formulas added
+    long failed;            ///< Formulas that could not be evaluated
+    long long elements[N];  ///< Atoms of every element
+    unsigned char overflow[N]; ///< 1 for the elements whose total does not fit in 64 bits
+    long long atoms;        ///< Atoms over all the formulas
+    int atomsOverflow;      ///< 1 if `atoms` does not fit in 64 bits
+    long long protonMin;    ///< Smallest proton total of a formula
+    long long protonMax;    ///< Largest proton total of a formula
+    double protonSum;       ///< Sum of the proton totals (for the mean)
+    long protonCount;       ///< Formulas with a proton total that fits in 64 bits
+    long histogram[PROTON_BUCKETS]; ///< Formulas by proton total, in powers of two
+    int top;                ///< Number of formulas in `largest`
+    BIGFORMULA largest[TOP_FORMULAS]; ///< The formulas with the most atoms, most first
+} AGGREGATE;
+
+
+AGGREGATE *createAggregate(void);
+void addFormula(AGGREGATE *agg, const long long counts[N], const PTABLE * const pert, const char *chem, int length, int line);
+void mergeAggregate(AGGREGATE *into, const AGGREGATE *from);
+void writeAggregate(WRITER *out, const AGGREGATE *agg, const PTABLE * const pert);
+
+#endif // AGGREGATE_H
@@ -0,0 +1,774 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "batch.h"
+#include "chemExt.h"
+#include "chemCompact.h"
+#include "chemIter.h"
+#include "chemCount.h"
+#include "elementIndex.h"
+#include "parenthesisBal.h"
+#include "protonNum.h"
+#include "cache.h"
+#include "stack.h"
+
+/**
+ * @brief State that a worker thread keeps from one formula to the next.
+ */
+typedef struct {
+    char *ext;              ///< Buffer for the extended formula
+    size_t extSize;         ///< Size of `ext`
+    CACHE *cache;           ///< Results of the formulas seen so far (NULL if disabled)
+    GROUPMEMO *memo;        ///< Compositions of the group bodies seen so far (NULL if disabled)
+    const PROPLIST *props;  ///< The properties computed by `PROPERTIES`
+    const BUDGET *budget;   ///< The limit on the extended formulas of `EXTEND`
+    AGGREGATE *agg;         ///< The totals of the formulas of the worker, for `SUMMARY`
+    void *scratch;          ///< Buffer for the element tokens of `countChem`
+    size_t scratchSize;     ///< Size of `scratch`
+    WRITER *result;         ///< Output of the current formula, when it may be cached
+    int timing;             ///< 1 to measure the time spent processing
+    STATS stats;            ///< Counters of the formulas processed by the worker
+} WORKER;
+
+/**
+ * @brief A run of consecutive formulas processed by one worker thread.
+ *
+ * The worker writes its results into memory; they are copied to the real
+ * output files afterwards, in the order of the chunks, so the output is the
+ * same as the output of a serial run.
+ */
+typedef struct {
+    MODE mode;              ///< The operation to perform
+    const PTABLE *pert;     ///< The periodic table, shared read-only by all workers
+    WORKER *w;              ///< The state of the worker that processes the chunk
+    const char **chem;      ///< The formulas of the chunk (views into the input)
+    size_t *length;         ///< The lengths of the formulas
+    int count;              ///< The number of formulas in the chunk
+    int line;               ///< The line number of the first formula
+    WRITER *out;            ///< Results for the output file, kept in memory
+    WRITER *msg;            ///< Messages for the console, kept in memory
+    int flag;               ///< EXIT_FAILURE if any formula of the chunk failed
+} CHUNK;
+
+/**
+ * @brief Current time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Reports a formula whose result does not fit (in memory or in 64 bits).
+ *
+ * @param what What could not be computed, for the console message.
+ */
+static void tooLarge(const char *chem, int length, int line, const char *what, WRITER *out, WRITER *msg) {
+    writeString(msg, "Formula in line: ");
+    writeInt(msg, line);
+    writeString(msg, " is too large to ");
+    writeString(msg, what);
+    writeChar(msg, '\n');
+    writeString(out, "Formula too large: ");
+    writeBytes(out, chem, length);
+    writeChar(out, '\n');
+}
+
+/**
+ * @brief Reports a formula that could not be processed because memory ran out.
+ */
+static void noMemory(const char *chem, int length, int line, WRITER *out, WRITER *msg) {
+    writeString(msg, "Out of memory processing line: ");
+    writeInt(msg, line);
+    writeChar(msg, '\n');
+    writeString(out, "Out of memory: ");
+    writeBytes(out, chem, length);
+    writeChar(out, '\n');
+}
+
+/**
+ * @brief Saves a checkpoint if `opt->interval` seconds have passed since the last one.
+ *
+ * It is only called between formulas, once their results are in `out`: the output is
+ * flushed first, so the output file holds exactly the results before the checkpoint.
+ *
+ * @param in The reader, right after the last formula processed.
+ * @param out The writer of the output file.
+ * @param line The line number of the next formula.
+ * @param opt The batch options.
+ */
+static void takeCheckpoint(READER *in, WRITER *out, int line, BATCH *opt) {
+    double t = now();
+    if (t - opt->saved < opt->interval) {
+        return;
+    }
+    if (flushWriter(out) == EXIT_FAILURE) {
+        return; // The write error is reported when the output is closed
+    }
+
+    CHECKPOINT c = opt->start;
+    c.input = readerOffset(in);
+    c.line = line;
+    c.output = opt->start.output + out->total;
+    if (saveCheckpoint(opt->checkpoint, &c) == EXIT_FAILURE) {
+        perror("Unable to save checkpoint");
+    }
+    opt->saved = t;
+}
+
+#ifdef WIDE_TOTALS
+/**
+ * @brief Appends a 128-bit integer in decimal.
+ */
+static void writeWide(WRITER *w, __int128 value) {
+    char digits[48];
+    int k = sizeof(digits);
+    unsigned __int128 u = (value < 0) ? -(unsigned __int128)value : (unsigned __int128)value;
+
+    do {
+        digits[--k] = '0' + (int)(u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (value < 0) {
+        digits[--k] = '-';
+    }
+    writeBytes(w, &digits[k], sizeof(digits) - k);
+}
+#endif
+
+/**
+ * @brief Processes a single formula and writes its result.
+ *
+ * @param mode The operation to perform.
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param line The line number of the formula, used in the messages.
+ * @param pert Pointer to the periodic table (only used by `PROTON` and `PROPERTIES`).
+ * @param memo The compositions of the groups seen so far, or NULL (only used by `PROTON` and `PROPERTIES`).
+ * @param props The properties to compute (only used by `PROPERTIES`).
+ * @param budget The limit on the length of the extended formula, or NULL (only used by `EXTEND`).
+ * @param ext Pointer to the buffer for the extended formula; it is grown as needed (only used by `EXTEND`).
+ * @param extSize Pointer to the size of `*ext`.
+ * @param out The writer of the output file (not used by `VERIFY`).
+ * @param msg The writer of the console messages.
+ * @param stats The counters that are updated.
+ * @return int Returns EXIT_SUCCESS if the formula was processed, or EXIT_FAILURE if it is unbalanced or too large.
+ */
+int processFormula(MODE mode, const char *chem, int length, int line, const PTABLE * const pert, GROUPMEMO *memo, const PROPLIST *props, const BUDGET *budget, char **ext, size_t *extSize, WRITER *out, WRITER *msg, STATS *stats) {
+    int flag;
+    long long atnum;
+    double values[PROPS];
+    EXTSIZE size;
+
+    switch (mode) {
+    case VERIFY:
+        flag = parB(chem, length); // Verify balanced parentheses in the formula
+        if (flag == EXIT_FAILURE) {
+            writeString(msg, "Parentheses are NOT balanced in line: ");
+            writeInt(msg, line);
+            writeChar(msg, '\n');
+            stats->unbalanced++;
+        }
+        return flag;
+
+    case EXTEND:
+        // Find the exact size of the expanded formula first, so nothing is written for one
+        // that is too large (`extenedChem` indexes the buffer with ints) or over the budget
+        flag = extendedSize(chem, length, &size);
+        if (flag == CHEM_NO_MEMORY) {
+            noMemory(chem, length, line, out, msg);
+            return EXIT_FAILURE;
+        }
+        // The budget comes first: an extended formula too large for memory is over it too
+        if (budget != NULL && budget->bytes > 0 && (flag == CHEM_OVERFLOW || (flag == EXIT_SUCCESS && size.length > budget->bytes))) {
+            MODE over = budget->over;
+            size_t runs;
+            if (over == RUNS && (compactSize(chem, length, &runs) != EXIT_SUCCESS || runs > budget->bytes)) {
+                over = HILL; // The runs are over the budget too
+            }
+            if (over != EXTEND) {
+                return processFormula(over, chem, length, line, pert, memo, props, NULL, ext, extSize, out, msg, stats);
+            }
+            tooLarge(chem, length, line, "extend within the budget", out, msg);
+            return EXIT_FAILURE;
+        }
+        if (flag == CHEM_OVERFLOW || (flag == EXIT_SUCCESS && size.buffer > INT_MAX)) {
+            tooLarge(chem, length, line, "extend", out, msg);
+            return EXIT_FAILURE;
+        }
+
+        if (flag == EXIT_SUCCESS) {
+            // Allocate the buffer once, at the exact size
+            if (size.buffer > *extSize) {
+                char *temp = (char *)realloc(*ext, size.buffer);
+                if (temp == NULL) {
+                    noMemory(chem, length, line, out, msg);
+                    return EXIT_FAILURE;
+                }
+                *ext = temp;
+                *extSize = size.buffer;
+                stats->bufferGrows++;
+            }
+            (*ext)[0] = '\0'; // Start from an empty expanded formula
+            flag = extenedChem(chem, length, *ext); // Expand the formula
+            if (flag == CHEM_NO_MEMORY) {
+                noMemory(chem, length, line, out, msg);
+                return EXIT_FAILURE;
+            }
+        }
+        if (flag == EXIT_FAILURE) {
+            writeString(msg, "Parentheses are NOT balanced in line: ");
+            writeInt(msg, line);
+            writeString(msg, " -- Failed to compute extended version\n");
+            writeString(out, "Parentheses are NOT balanced: ");
+            writeBytes(out, chem, length);
+            writeChar(out, '\n');
+            stats->unbalanced++;
+        } else {
+            writeBytes(out, *ext, size.length); // Write the expanded formula to the output file
+            writeChar(out, '\n');
+            if (length > 0 && (double)size.length / length > stats->ratio) {
+                stats->ratio = (double)size.length / length;
+            }
+        }
+        return flag;
+
+    case RUNS:
+    case HILL:
+    case ATOMS:
+        // Write the compact form, or the atoms one by one, straight from the formula
+        flag = (mode == RUNS) ? compactChem(chem, length, out) : (mode == HILL) ? hillChem(chem, length, out) : atomsChem(chem, length, out);
+        if (flag == CHEM_OVERFLOW) {
+            tooLarge(chem, length, line, "extend", out, msg);
+            return EXIT_FAILURE;
+        }
+        if (flag == CHEM_NO_MEMORY) {
+            noMemory(chem, length, line, out, msg);
+            return EXIT_FAILURE;
+        }
+        if (flag == EXIT_FAILURE) {
+            writeString(msg, "Parentheses are NOT balanced in line: ");
+            writeInt(msg, line);
+            writeString(msg, " -- Failed to compute extended version\n");
+            writeString(out, "Parentheses are NOT balanced: ");
+            writeBytes(out, chem, length);
+            stats->unbalanced++;
+        }
+        writeChar(out, '\n');
+        return flag;
+
+    case PROTON:
+        // Add up the atomic numbers in one pass, without expanding the formula
+        flag = protonChem(chem, length, &atnum, pert, memo, out);
+#ifdef WIDE_TOTALS
+        if (flag == CHEM_OVERFLOW) {
+            // Compute the total again in 128 bits
+            __int128 wide;
+            flag = protonWide(chem, length, &wide, pert);
+            if (flag == EXIT_SUCCESS) {
+                writeWide(out, wide);
+                writeChar(out, '\n');
+                return flag;
+            }
+        }
+#endif
+        if (flag == EXIT_SUCCESS) {
+            writeInt(out, atnum); // Write result to output file
+            writeChar(out, '\n');
+        } else if (flag == CHEM_OVERFLOW) {
+            tooLarge(chem, length, line, "compute its proton number", out, msg);
+            return EXIT_FAILURE;
+        } else if (flag == CHEM_NO_MEMORY) {
+            noMemory(chem, length, line, out, msg);
+            return EXIT_FAILURE;
+        } else {
+            writeString(out, "Error processing formula: ");
+            writeBytes(out, chem, length);
+            writeChar(out, '\n');
+            stats->unbalanced++;
+        }
+        return flag;
+
+    case PROPERTIES:
+        // Evaluate the formula once and add up every property over its element counts
+        flag = propsChem(chem, length, props, values, pert, memo, out);
+        if (flag == EXIT_SUCCESS) {
+            writeProperties(out, props, values);
+            writeChar(out, '\n');
+        } else if (flag == CHEM_OVERFLOW) {
+            tooLarge(chem, length, line, "compute its properties", out, msg);
+            return EXIT_FAILURE;
+        } else if (flag == CHEM_NO_MEMORY) {
+            noMemory(chem, length, line, out, msg);
+            return EXIT_FAILURE;
+        } else {
+            writeString(out, "Error processing formula: ");
+            writeBytes(out, chem, length);
+            writeChar(out, '\n');
+            stats->unbalanced++;
+        }
+        return flag;
+
+    case SUMMARY:
+    case INDEX:
+        break; // Handled by `runFormula`, which holds the totals and the token buffer of the worker
+    }
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Creates the state of a worker.
+ *
+ * @param opt The batch options (for the sizes of the cache and the memo).
+ * @return WORKER* The worker; the program exits if memory allocation fails.
+ */
+static WORKER *createWorker(const BATCH *opt) {
+    WORKER *w = (WORKER *)calloc(1, sizeof(WORKER));
+    if (w == NULL) {
+        perror("Memory allocation failed");
+        exit(-1);
+    }
+    if (opt->cacheSize > 0) {
+        w->cache = createCache(opt->cacheSize);
+        w->result = memoryWriter(CACHE_VALUE_MAX);
+        if (w->cache == NULL || w->result == NULL) {
+            perror("Memory allocation failed");
+            exit(-1);
+        }
+    }
+    if (opt->memoSize > 0) {
+        w->memo = createMemo(opt->memoSize);
+        if (w->memo == NULL) {
+            perror("Memory allocation failed");
+            exit(-1);
+        }
+    }
+    if (opt->agg != NULL) {
+        w->agg = createAggregate();
+        if (w->agg == NULL) {
+            perror("Memory allocation failed");
+            exit(-1);
+        }
+    }
+    w->props = &opt->props;
+    w->budget = &opt->budget;
+    w->timing = opt->stats;
+    return w;
+}
+
+/**
+ * @brief Adds the counters of a worker to the batch and releases it.
+ */
+static void freeWorker(WORKER *w, BATCH *opt) {
+    if (w->cache != NULL) {
+        opt->hits += w->cache->hits;
+        opt->misses += w->cache->misses;
+        opt->evictions += w->cache->evictions;
+    }
+    if (w->memo != NULL) {
+        opt->memoHits += w->memo->hits;
+    }
+    opt->totals.lines += w->stats.lines;
+    opt->totals.unbalanced += w->stats.unbalanced;
+    opt->totals.failed += w->stats.failed;
+    opt->totals.pushes += w->stats.pushes;
+    opt->totals.pops += w->stats.pops;
+    opt->totals.bufferGrows += w->stats.bufferGrows;
+    opt->totals.readTime += w->stats.readTime;
+    opt->totals.processTime += w->stats.processTime;
+    if (w->stats.ratio > opt->totals.ratio) {
+        opt->totals.ratio = w->stats.ratio;
+    }
+    if (w->agg != NULL) {
+        mergeAggregate(opt->agg, w->agg);
+        free(w->agg);
+    }
+    freeMemo(w->memo);
+    freeCache(w->cache);
+    closeWriter(w->result);
+    free(w->scratch);
+    free(w->ext);
+    free(w);
+}
+
+/**
+ * @brief Computes the element counts of a formula, reporting it on the console if it fails.
+ *
+ * @return int Returns EXIT_SUCCESS if the formula was counted, or EXIT_FAILURE.
+ */
+static int countFormula(WORKER *w, const char *chem, int length, int line, const PTABLE * const pert, long long counts[N], WRITER *msg) {
+    int flag = countChem(chem, length, counts, pert, w->memo, NULL, &w->scratch, &w->scratchSize);
+    if (flag == EXIT_SUCCESS) {
+        return EXIT_SUCCESS;
+    }
+
+    if (flag == EXIT_FAILURE) {
+        writeString(msg, "Parentheses are NOT balanced in line: ");
+        w->stats.unbalanced++;
+    } else if (flag == CHEM_OVERFLOW) {
+        writeString(msg, "Too many atoms to count in line: ");
+    } else if (flag == CHEM_UNKNOWN) {
+        writeString(msg, "Unknown element in line: ");
+    } else {
+        writeString(msg, "Out of memory processing line: ");
+    }
+    writeInt(msg, line);
+    writeChar(msg, '\n');
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Adds the element counts of a formula to the totals of the worker (`SUMMARY`).
+ *
+ * Nothing is written to the output file; the formulas that cannot be counted
+ * are reported on the console and left out of the totals.
+ *
+ * @return int Returns EXIT_SUCCESS if the formula was added, or EXIT_FAILURE.
+ */
+static int summarizeFormula(WORKER *w, const char *chem, int length, int line, const PTABLE * const pert, WRITER *msg) {
+    long long counts[N];
+
+    if (countFormula(w, chem, length, line, pert, counts, msg) == EXIT_FAILURE) {
+        w->agg->failed++;
+        return EXIT_FAILURE;
+    }
+    addFormula(w->agg, counts, pert, chem, length, line);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes the index record of a formula (`INDEX`).
+ *
+ * Every formula gets a record, so the records stay in step with the lines; the
+ * formulas that cannot be counted get a failed record and are reported on the console.
+ *
+ * @return int Returns EXIT_SUCCESS if the formula was counted, or EXIT_FAILURE.
+ */
+static int indexFormula(WORKER *w, const char *chem, int length, int line, const PTABLE * const pert, WRITER *out, WRITER *msg) {
+    long long counts[N];
+
+    if (countFormula(w, chem, length, line, pert, counts, msg) == EXIT_FAILURE) {
+        writeIndexFailed(out);
+        return EXIT_FAILURE;
+    }
+    writeIndexRecord(out, counts);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reports a formula longer than INT_MAX bytes, which no engine can process.
+ *
+ * It is counted as failed and, like any formula that fails, keeps its place in the
+ * output: a message, a failed index record, or nothing with `VERIFY` and `SUMMARY`.
+ */
+static void tooLong(WORKER *w, MODE mode, const char *chem, size_t length, int line, WRITER *out, WRITER *msg) {
+    writeString(msg, "Formula in line: ");
+    writeInt(msg, line);
+    writeString(msg, " is too long to process\n");
+    w->stats.failed++;
+    if (mode == SUMMARY) {
+        w->agg->failed++;
+    } else if (mode == INDEX) {
+        writeIndexFailed(out);
+    } else if (mode != VERIFY) {
+        writeString(out, "Formula too large: ");
+        writeBytes(out, chem, length);
+        writeChar(out, '\n');
+    }
+}
+
+/**
+ * @brief Processes a single formula, going through the result cache of the worker.
+ *
+ * Only successful results are cached: they produce no console messages, so the
+ * cached output is the same wherever the formula appears in the file.
+ *
+ * @return int Returns EXIT_SUCCESS if the formula was processed, or EXIT_FAILURE if it is unbalanced.
+ */
+static int runFormula(WORKER *w, MODE mode, const char *chem, size_t length, int line, const PTABLE * const pert, WRITER *out, WRITER *msg) {
+    int flag;
+
+    w->stats.lines++;
+    if (length > INT_MAX) {
+        tooLong(w, mode, chem, length, line, out, msg); // The engines index the formulas with ints
+        return EXIT_FAILURE;
+    }
+    if (mode == SUMMARY) {
+        flag = summarizeFormula(w, chem, length, line, pert, msg); // Nothing to cache: there is no output
+    } else if (mode == INDEX) {
+        flag = indexFormula(w, chem, length, line, pert, out, msg);
+    } else if (w->cache == NULL) {
+        flag = processFormula(mode, chem, length, line, pert, w->memo, w->props, w->budget, &w->ext, &w->extSize, out, msg, &w->stats);
+    } else {
+        const ENTRY *e = findCache(w->cache, chem, length);
+        if (e != NULL) {
+            if (out != NULL) {
+                writeBytes(out, e->value, e->vlen);
+            }
+            return EXIT_SUCCESS;
+        }
+
+        w->result->len = 0;
+        flag = processFormula(mode, chem, length, line, pert, w->memo, w->props, w->budget, &w->ext, &w->extSize, w->result, msg, &w->stats);
+        if (out != NULL) {
+            writeBytes(out, w->result->buf, w->result->len);
+        }
+        if (flag == EXIT_SUCCESS) {
+            addCache(w->cache, chem, length, w->result->buf, w->result->len);
+        }
+    }
+    if (flag == EXIT_FAILURE) {
+        w->stats.failed++;
+    }
+    return flag;
+}
+
+/**
+ * @brief Worker thread: processes every formula of a chunk into memory.
+ *
+ * @param arg Pointer to the `CHUNK`.
+ * @return NULL
+ */
+static void *runChunk(void *arg) {
+    CHUNK *c = (CHUNK *)arg;
+    WORKER *w = c->w;
+    double start = w->timing ? now() : 0;
+
+    c->flag = EXIT_SUCCESS;
+    for (int i = 0; i < c->count; i++) {
+        if (runFormula(w, c->mode, c->chem[i], c->length[i], c->line + i, c->pert, c->out, c->msg) == EXIT_FAILURE) {
+            c->flag = EXIT_FAILURE;
+        }
+    }
+    if (w->timing) {
+        w->stats.processTime += now() - start;
+    }
+    takeStackCounts(&w->stats.pushes, &w->stats.pops, &w->stats.bufferGrows);
+    return NULL;
+}
+
+/**
+ * @brief Reads up to `max` formulas, holding them all in the reader.
+ *
+ * The buffer of the reader may move while reading, so the formulas are located
+ * through their offsets once the whole round has been read.
+ *
+ * @return int The number of formulas read.
+ */
+static int readRound(READER *in, const char **chem, size_t *offset, size_t *length, int max) {
+    const char *view;
+    size_t len;
+    int count;
+
+    for (count = 0; count < max && nextFormula(in, &view, &len); count++) {
+        offset[count] = view - heldFormulas(in);
+        length[count] = len;
+    }
+    for (int i = 0; i < count; i++) {
+        chem[i] = heldFormulas(in) + offset[i];
+    }
+    return count;
+}
+
+/**
+ * @brief Processes the input file on `jobs` worker threads.
+ *
+ * The file is read in rounds of up to `jobs * CHUNK_LINES` formulas. Every round is
+ * split into one chunk per worker, and once all the workers are done the results
+ * are written chunk by chunk, so the output keeps the order of the input.
+ *
+ * @return int Returns EXIT_SUCCESS if every formula was processed, EXIT_FAILURE otherwise.
+ */
+static int processParallel(MODE mode, READER *in, WRITER *out, WRITER *msg, const PTABLE * const pert, BATCH *opt) {
+    int jobs = opt->jobs;
+    int flag = EXIT_SUCCESS;
+    int line = opt->start.line;
+    int max = jobs * CHUNK_LINES;
+    const char **chem = (const char **)malloc(max * sizeof(char *));
+    size_t *offset = (size_t *)malloc(max * sizeof(size_t));
+    size_t *length = (size_t *)malloc(max * sizeof(size_t));
+    CHUNK *chunks = (CHUNK *)malloc(jobs * sizeof(CHUNK));
+    pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+
+    if (chem == NULL || offset == NULL || length == NULL || chunks == NULL || threads == NULL) {
+        perror("Memory allocation failed");
+        exit(-1);
+    }
+    for (int t = 0; t < jobs; t++) {
+        chunks[t].w = createWorker(opt);
+        chunks[t].out = memoryWriter(WRITE_SIZE);
+        chunks[t].msg = memoryWriter(WRITE_SIZE);
+        if (chunks[t].out == NULL || chunks[t].msg == NULL) {
+            perror("Memory allocation failed");
+            exit(-1);
+        }
+    }
+
+    int count;
+    do {
+        // Read the next round of formulas
+        double start = opt->stats ? now() : 0;
+        count = readRound(in, chem, offset, length, max);
+        if (opt->stats) {
+            opt->totals.readTime += now() - start;
+        }
+
+        int per = (count + jobs - 1) / jobs; // Formulas per worker
+        int started = 0;
+        for (int t = 0; t < jobs && t * per < count; t++) {
+            CHUNK *c = &chunks[t];
+            c->mode = mode;
+            c->pert = pert;
+            c->chem = &chem[t * per];
+            c->length = &length[t * per];
+            c->count = (count - t * per < per) ? count - t * per : per;
+            c->line = line + t * per;
+            if (pthread_create(&threads[t], NULL, runChunk, c) != 0) {
+                perror("Unable to create thread");
+                exit(-1);
+            }
+            started++;
+        }
+
+        // Write the results in the original order
+        for (int t = 0; t < started; t++) {
+            pthread_join(threads[t], NULL);
+            writeBytes(msg, chunks[t].msg->buf, chunks[t].msg->len);
+            if (out != NULL) {
+                writeBytes(out, chunks[t].out->buf, chunks[t].out->len);
+            }
+            if (chunks[t].flag == EXIT_FAILURE) {
+                flag = EXIT_FAILURE;
+            }
+            chunks[t].msg->len = 0; // Reuse the memory in the next round
+            chunks[t].out->len = 0;
+        }
+
+        releaseFormulas(in);
+        line += count;
+        if (opt->checkpoint != NULL) {
+            takeCheckpoint(in, out, line, opt);
+        }
+    } while (count == max);
+
+    for (int t = 0; t < jobs; t++) {
+        freeWorker(chunks[t].w, opt);
+        closeWriter(chunks[t].out);
+        closeWriter(chunks[t].msg);
+    }
+    free(threads);
+    free(chunks);
+    free(length);
+    free(offset);
+    free(chem);
+    return flag;
+}
+
+/**
+ * @brief Processes the input file on the calling thread, measuring the time of every phase.
+ *
+ * The formulas are read and processed in rounds of `CHUNK_LINES`, so the clock is
+ * read a few times per round instead of around every formula.
+ *
+ * @return int Returns EXIT_SUCCESS if every formula was processed, EXIT_FAILURE otherwise.
+ */
+static int processTimed(MODE mode, READER *in, WRITER *out, WRITER *msg, const PTABLE * const pert, BATCH *opt) {
+    int flag = EXIT_SUCCESS;
+    int line = opt->start.line;
+    const char **chem = (const char **)malloc(CHUNK_LINES * sizeof(char *));
+    size_t *offset = (size_t *)malloc(CHUNK_LINES * sizeof(size_t));
+    size_t *length = (size_t *)malloc(CHUNK_LINES * sizeof(size_t));
+    WORKER *w = createWorker(opt);
+
+    if (chem == NULL || offset == NULL || length == NULL) {
+        perror("Memory allocation failed");
+        exit(-1);
+    }
+
+    int count;
+    do {
+        double start = now();
+        count = readRound(in, chem, offset, length, CHUNK_LINES);
+        double read = now();
+        double written = msg->seconds + ((out != NULL) ? out->seconds : 0);
+        for (int i = 0; i < count; i++) {
+            if (runFormula(w, mode, chem[i], length[i], line + i, pert, out, msg) == EXIT_FAILURE) {
+                flag = EXIT_FAILURE;
+            }
+        }
+        w->stats.readTime += read - start;
+        // The output written while processing is reported as writing time
+        w->stats.processTime += now() - read - (msg->seconds + ((out != NULL) ? out->seconds : 0) - written);
+
+        releaseFormulas(in);
+        line += count;
+        if (opt->checkpoint != NULL) {
+            takeCheckpoint(in, out, line, opt);
+        }
+    } while (count == CHUNK_LINES);
+
+    takeStackCounts(&w->stats.pushes, &w->stats.pops, &w->stats.bufferGrows);
+    freeWorker(w, opt);
+    free(length);
+    free(offset);
+    free(chem);
+    return flag;
+}
+
+/**
+ * @brief Processes every formula of the input file.
+ *
+ * The line numbers start at `opt->start.line`, for a run that continues an earlier one
+ * from the position of the reader. With `opt->checkpoint`, the progress of the run is
+ * saved there every `opt->interval` seconds, between two rounds of formulas.
+ *
+ * @param mode The operation to perform.
+ * @param in The reader of the input file.
+ * @param out The writer of the output file (NULL for `VERIFY`).
+ * @param msg The writer of the console messages.
+ * @param pert Pointer to the periodic table (only used by `PROTON`).
+ * @param opt The batch options; the counters of the run are added to it.
+ * @return int Returns EXIT_SUCCESS if every formula was processed, EXIT_FAILURE otherwise.
+ */
+int processFile(MODE mode, READER *in, WRITER *out, WRITER *msg, const PTABLE * const pert, BATCH *opt) {
+    if (opt->start.line == 0) {
+        opt->start.line = 1;
+    }
+    if (opt->checkpoint != NULL) {
+        opt->saved = now();
+    }
+    if (opt->jobs > 1) {
+        return processParallel(mode, in, out, msg, pert, opt);
+    }
+    if (opt->stats) {
+        return processTimed(mode, in, out, msg, pert, opt);
+    }
+
+    int flag = EXIT_SUCCESS;
+    int line = opt->start.line;
+    const char *chem;
+    size_t length;
+    WORKER *w = createWorker(opt);
+
+    // Process each formula in the input file
+    while (nextFormula(in, &chem, &length)) {
+        if (runFormula(w, mode, chem, length, line, pert, out, msg) == EXIT_FAILURE) {
+            flag = EXIT_FAILURE;
+        }
+        releaseFormulas(in);
+        line++; // Increment line number
+        if (opt->checkpoint != NULL && line % CHUNK_LINES == 0) {
+            takeCheckpoint(in, out, line, opt); // The clock is only read once per chunk
+        }
+    }
+
+    takeStackCounts(&w->stats.pushes, &w->stats.pops, &w->stats.bufferGrows);
+    freeWorker(w, opt);
+    return flag;
+}
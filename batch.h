@@ -0,0 +1,84 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "periodicTable.h" // Include the periodic table definition
+#include "reader.h"
+#include "writer.h"
+#include "groupMemo.h"
+#include "chemProps.h"
+#include "aggregate.h"
+#include "checkpoint.h"
+
+#define CHUNK_LINES 16384   ///< Number of formulas a worker thread processes at a time
+
+/**
+ * @brief The operation performed on every formula of the input file.
+ */
+typedef enum {
+    VERIFY,   ///< `-v`: verify that the parentheses are balanced
+    EXTEND,   ///< `-ext`: compute the extended version of the formula
+    RUNS,     ///< `-ext --compact runs`: the extended version as `symbol count` runs
+    HILL,     ///< `-ext --compact hill`: the atoms of every element, in Hill order
+    ATOMS,    ///< `-ext --stream`: the extended version written one atom at a time, without building it
+    PROTON,   ///< `-pn`: compute the total proton number of the formula
+    PROPERTIES, ///< `-mass`/`-props`: add up per-element properties (mass, ...) over the formula
+    SUMMARY,  ///< `-agg`: add the element counts of the formula to the totals of the whole file
+    INDEX     ///< `-index`: write the elements present in the formula and their atoms, in binary
+} MODE;
+
+/**
+ * @brief Limit on the length of the extended formulas written by `EXTEND`.
+ *
+ * The exact length is known before the formula is expanded, so a formula over the
+ * limit is never expanded: it is reported as too large, or written in a compact form.
+ */
+typedef struct {
+    size_t bytes;       ///< Longest extended formula that is written (0 for no limit)
+    MODE over;          ///< What is done over the limit: `EXTEND` reports it, `RUNS` or `HILL` write that form (`RUNS` over the limit too writes `HILL`)
+} BUDGET;
+
+/**
+ * @brief Counters of a run, reported by `--stats`.
+ *
+ * The counts are always kept; the times are only measured when `BATCH.stats` is set.
+ */
+typedef struct {
+    long lines;         ///< Formulas processed
+    long unbalanced;    ///< Formulas with unbalanced parentheses
+    long failed;        ///< Formulas that could not be processed (including the unbalanced ones)
+    long pushes;        ///< Stack pushes
+    long pops;          ///< Stack pops
+    long bufferGrows;   ///< Times a parse stack or the extended formula buffer had to grow (other allocations are not counted)
+    double ratio;       ///< Largest ratio of the length of an extended formula to the formula
+    double readTime;    ///< Seconds spent finding the formulas in the input
+    double processTime; ///< Seconds spent processing the formulas (added up over the workers)
+} STATS;
+
+/**
+ * @brief Options of a run over a whole file, and the counters it reports back.
+ */
+typedef struct {
+    int jobs;           ///< Number of worker threads (1 processes the file on the calling thread)
+    int cacheSize;      ///< Entries of the result cache of every worker (0 disables the cache)
+    int memoSize;       ///< Group bodies remembered by every worker (0 disables the memo)
+    long hits;          ///< Result cache hits
+    long misses;        ///< Result cache misses
+    long evictions;     ///< Result cache evictions
+    long memoHits;      ///< Groups that were not parsed again thanks to the memo
+    int stats;          ///< 1 to measure the time spent in every phase
+    PROPLIST props;     ///< The properties computed by `PROPERTIES`
+    BUDGET budget;      ///< The limit on the extended formulas of `EXTEND`
+    AGGREGATE *agg;     ///< The totals of `SUMMARY` (NULL in the other modes)
+    const char *checkpoint; ///< File that records the progress of the run, or NULL
+    double interval;    ///< Seconds between two checkpoints
+    double saved;       ///< When the last checkpoint was saved
+    CHECKPOINT start;   ///< Where the run starts (all zeros for the beginning); `mode` goes into every checkpoint
+    STATS totals;       ///< Counters of the run
+} BATCH;
+
+
+int processFormula(MODE mode, const char *chem, int length, int line, const PTABLE * const pert, GROUPMEMO *memo, const PROPLIST *props, const BUDGET *budget, char **ext, size_t *extSize, WRITER *out, WRITER *msg, STATS *stats);
+int processFile(MODE mode, READER *in, WRITER *out, WRITER *msg, const PTABLE * const pert, BATCH *opt);
+
+#endif // BATCH_H
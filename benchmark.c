@@ -0,0 +1,414 @@
+#ifdef BENCH
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "periodicTable.h"
+#include "chemExt.h"
+#include "chemCount.h"
+#include "chemProps.h"
+#include "parenthesisBal.h"
+#include "protonNum.h"
+#include "batch.h"
+#include "reader.h"
+#include "writer.h"
+
+#define BENCH_COUNT 20000       ///< Default number of formulas generated for every workload
+#define ARENA_SIZE (16 << 20)   ///< Expanded formulas kept at a time for timing `atomicNum`
+#define POOL_SIZE 20            ///< Distinct formulas of the `repeat` workload
+
+/*
+ * Allocation counting. Link with
+ *     -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+ * so every allocation of the program goes through these wrappers; without
+ * the flags the counters stay at zero and are reported as "n/a".
+ */
+static long allocations = 0;
+static int wrapped = 0;
+
+// Weak, so the program still links without the flags (the wrappers are then never called)
+void *__real_malloc(size_t size) __attribute__((weak));
+void *__real_calloc(size_t n, size_t size) __attribute__((weak));
+void *__real_realloc(void *p, size_t size) __attribute__((weak));
+
+void *__wrap_malloc(size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    wrapped = 1;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    wrapped = 1;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    wrapped = 1;
+    return __real_realloc(p, size);
+}
+
+/**
+ * @brief The kinds of generated workloads.
+ */
+typedef enum {
+    SIMPLE,      ///< Small real molecules
+    NESTED,      ///< Deeply nested groups
+    MULTIPLIER,  ///< Large (two digit) multipliers
+    LONGLINE,    ///< Very long formulas made of many groups
+    REPEAT,      ///< A few distinct formulas repeated many times
+    KINDS        ///< Number of kinds
+} KIND;
+
+static const char *kindNames[KINDS] = { "simple", "nested", "multiplier", "long", "repeat" };
+
+static const char *molecules[] = {
+    "H2O", "CO2", "NaCl", "C6H12O6", "Ca(OH)2", "Fe2(SO4)3", "CH3COOH", "NH4NO3",
+    "KMnO4", "Mg(OH)2", "Al2(SO4)3", "C2H5OH", "H2SO4", "CaCO3", "(NH4)2SO4", "Cu(NO3)2",
+    "C8H10N4O2", "Ca3(PO4)2", "K4Fe(CN)6", "C12H22O11"
+};
+static const char *elements[] = { "H", "C", "N", "O", "F", "Na", "Mg", "Al", "Si", "P", "S", "Cl", "K", "Ca", "Fe", "Cu" };
+static const char *units[] = { "(CH2)", "(C6H4)", "(CH2CH(C6H5))", "(OCH2CH2)", "(CF2CF2)", "(NH2)" };
+
+static unsigned long long seed = 88172645463325252ULL;
+
+/**
+ * @brief Pseudo-random number in [0, n) (xorshift64).
+ */
+static int rnd(int n) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (int)(seed % n);
+}
+
+/**
+ * @brief Appends a random element symbol, optionally with a multiplier up to `max`.
+ */
+static void genElement(WRITER *w, int max) {
+    writeString(w, elements[rnd(sizeof(elements) / sizeof(elements[0]))]);
+    if (max > 1 && rnd(2)) {
+        writeInt(w, 2 + rnd(max - 1));
+    }
+}
+
+/**
+ * @brief Appends a group nested `depth` levels deep, every level repeated twice.
+ */
+static void genNested(WRITER *w, int depth) {
+    genElement(w, 3);
+    if (depth > 0) {
+        writeChar(w, '(');
+        genNested(w, depth - 1);
+        writeString(w, ")2");
+    }
+    genElement(w, 3);
+}
+
+/**
+ * @brief Appends one generated formula of the given kind (without the newline).
+ */
+static void genFormula(WRITER *w, KIND kind) {
+    static char pool[POOL_SIZE][64];
+    static int poolReady = 0;
+    int n;
+
+    switch (kind) {
+    case SIMPLE:
+        writeString(w, molecules[rnd(sizeof(molecules) / sizeof(molecules[0]))]);
+        break;
+    case NESTED:
+        genNested(w, 6 + rnd(5));
+        break;
+    case MULTIPLIER:
+        n = 3 + rnd(4);
+        for (int i = 0; i < n; i++) {
+            if (rnd(3) == 0) {
+                writeChar(w, '(');
+                genElement(w, 20);
+                genElement(w, 20);
+                writeChar(w, ')');
+                writeInt(w, 10 + rnd(90));
+            } else {
+                genElement(w, 99);
+            }
+        }
+        break;
+    case LONGLINE:
+        n = 200 + rnd(200);
+        for (int i = 0; i < n; i++) {
+            writeString(w, units[rnd(sizeof(units) / sizeof(units[0]))]);
+            writeInt(w, 1 + rnd(9));
+        }
+        break;
+    case REPEAT:
+        if (!poolReady) {
+            for (int i = 0; i < POOL_SIZE; i++) {
+                WRITER *p = memoryWriter(64);
+                genFormula(p, (i % 2) ? SIMPLE : MULTIPLIER);
+                snprintf(pool[i], sizeof(pool[i]), "%.*s", (int)p->len, p->buf);
+                closeWriter(p);
+            }
+            poolReady = 1;
+        }
+        writeString(w, pool[rnd(POOL_SIZE)]);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Generates `count` formulas of a kind, one per line.
+ *
+ * @return WRITER* An in-memory writer holding the workload.
+ */
+static WRITER *generate(KIND kind, int count) {
+    WRITER *w = memoryWriter(1 << 20);
+    for (int i = 0; i < count; i++) {
+        genFormula(w, kind);
+        writeChar(w, '\n');
+    }
+    return w;
+}
+
+/**
+ * @brief Current time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Peak resident set size of the process in KB.
+ */
+static long peakRSS(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/**
+ * @brief Prints one line of results.
+ */
+static void report(const char *kind, const char *name, int count, size_t bytes, double secs, long allocs) {
+    if (secs <= 0) secs = 1e-9;
+    printf("%-10s %-14s %12.0f %10.1f ", kind, name, count / secs, bytes / secs / 1e6);
+    if (wrapped)
+        printf("%10ld", allocs);
+    else
+        printf("%10s", "n/a");
+    printf(" %10ld\n", peakRSS());
+}
+
+/**
+ * @brief Runs every benchmark on one workload.
+ */
+static void benchKind(KIND kind, int count, const PTABLE *pert) {
+    const char *name = kindNames[kind];
+    WRITER *work = generate(kind, count);
+    const char *data = work->buf;
+    size_t bytes = work->len;
+    double t, total;
+    long a;
+    int atnum;
+    long long sum, counts[N];
+
+    // Index the lines of the workload
+    const char **chem = (const char **)malloc(count * sizeof(char *));
+    int *length = (int *)malloc(count * sizeof(int));
+    for (int i = 0, p = 0; i < count; i++) {
+        chem[i] = data + p;
+        length[i] = strchr(data + p, '\n') - (data + p);
+        p += length[i] + 1;
+    }
+
+    // parB
+    a = allocations;
+    t = now();
+    for (int i = 0; i < count; i++) {
+        parB(chem[i], length[i]);
+    }
+    report(name, "parB", count, bytes, now() - t, allocations - a);
+
+    // The exact-size pre-pass of -ext
+    EXTSIZE es;
+    a = allocations;
+    t = now();
+    for (int i = 0; i < count; i++) {
+        extendedSize(chem[i], length[i], &es);
+    }
+    report(name, "extendedSize", count, bytes, now() - t, allocations - a);
+
+    // extenedChem, and atomicNum on the expanded formulas
+    FILE *devnull = fopen("/dev/null", "w");
+    char *arena = (char *)malloc(ARENA_SIZE);
+    char *ext = NULL;
+    size_t extSize = 0, used = 0;
+    double extTime = 0, atomTime = 0;
+    long extAllocs = 0, atomAllocs = 0;
+    for (int i = 0; i <= count; i++) {
+        size_t size = 0;
+        if (i < count) {
+            if (extendedSize(chem[i], length[i], &es) != EXIT_SUCCESS) {
+                continue; // Unbalanced or too large: there is nothing to expand
+            }
+            size = es.buffer;
+        }
+        if (i == count || used + size > ARENA_SIZE) {
+            // Time atomicNum over the expansions collected so far
+            a = allocations;
+            t = now();
+            for (size_t p = 0; p < used; p += strlen(arena + p) + 1) {
+                atnum = 0;
+                atomicNum(arena + p, &atnum, pert, devnull);
+            }
+            atomTime += now() - t;
+            atomAllocs += allocations - a;
+            used = 0;
+            if (i == count) break;
+        }
+        a = allocations;
+        t = now();
+        if (size > extSize) {
+            free(ext);
+            ext = (char *)malloc(size);
+            extSize = size;
+        }
+        ext[0] = '\0';
+        extenedChem(chem[i], length[i], ext);
+        extTime += now() - t;
+        extAllocs += allocations - a;
+        if (size <= ARENA_SIZE) {
+            size_t len = strlen(ext) + 1;
+            memcpy(arena + used, ext, len);
+            used += len;
+        }
+    }
+    report(name, "extenedChem", count, bytes, extTime, extAllocs);
+    report(name, "atomicNum", count, bytes, atomTime, atomAllocs);
+    free(ext);
+    free(arena);
+
+    // protonChem and countChem
+    WRITER *sink = fdWriter(fileno(devnull), WRITE_SIZE);
+    a = allocations;
+    t = now();
+    for (int i = 0; i < count; i++) {
+        protonChem(chem[i], length[i], &sum, pert, NULL, sink);
+    }
+    report(name, "protonChem", count, bytes, now() - t, allocations - a);
+    a = allocations;
+    t = now();
+    for (int i = 0; i < count; i++) {
+        countChem(chem[i], length[i], counts, pert, NULL, sink, NULL, NULL);
+    }
+    report(name, "countChem", count, bytes, now() - t, allocations - a);
+    PROPLIST props;
+    double values[PROPS];
+    parseProperties("mass,anum,electrons,valence", &props);
+    a = allocations;
+    t = now();
+    for (int i = 0; i < count; i++) {
+        propsChem(chem[i], length[i], &props, values, pert, NULL, sink);
+    }
+    report(name, "propsChem", count, bytes, now() - t, allocations - a);
+
+    // End to end: the three modes over a file
+    char path[] = "/tmp/benchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0 && write(fd, data, bytes) == (ssize_t)bytes) {
+        MODE modes[] = { VERIFY, EXTEND, PROTON };
+        const char *names[] = { "-v", "-ext", "-pn" };
+        for (int m = 0; m < 3; m++) {
+            BATCH opt = { .jobs = 1 };
+            a = allocations;
+            t = now();
+            READER *in = openReader(path);
+            processFile(modes[m], in, (modes[m] == VERIFY) ? NULL : sink, sink, pert, &opt);
+            flushWriter(sink);
+            closeReader(in);
+            total = now() - t;
+            report(name, names[m], count, bytes, total, allocations - a);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+        unlink(path);
+    }
+
+    closeWriter(sink);
+    fclose(devnull);
+    free(length);
+    free(chem);
+    closeWriter(work);
+}
+
+/**
+ * @brief Benchmark of the formula parsers on generated workloads.
+ *
+ * Usage:
+ * - `benchmark <table> [count] [kind]`: time `parB`, `extenedChem`, `atomicNum`,
+ *   `protonChem`, `countChem`, `propsChem` (all four properties) and the `-v`/`-ext`/`-pn`
+ *   modes on `count` formulas of every kind (or only the given kind).
+ * - `benchmark <table> -gen <kind> <count> <file>`: write a generated workload to a
+ *   file, to be used with parseFormula.
+ *
+ * The table may be `-` for the built-in periodic table.
+ *
+ * Throughput is reported in formulas/s and MB/s of input, together with the number
+ * of allocations and the peak resident set size (KB) so far.
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <table> [count] [kind] OR Usage: %s <table> -gen <kind> <count> <file>\n", argv[0], argv[0]);
+        return -1;
+    }
+
+    if (argc >= 6 && strcmp(argv[2], "-gen") == 0) {
+        for (int k = 0; k < KINDS; k++) {
+            if (strcmp(argv[3], kindNames[k]) == 0) {
+                FILE *out = fopen(argv[5], "w");
+                if (out == NULL) {
+                    perror("Unable to open output file");
+                    return -1;
+                }
+                WRITER *w = generate(k, atoi(argv[4]));
+                fwrite(w->buf, 1, w->len, out);
+                closeWriter(w);
+                fclose(out);
+                return 0;
+            }
+        }
+        printf("Unknown kind: %s\n", argv[3]);
+        return -1;
+    }
+
+    const PTABLE *pert;
+    char err[CHEM_ERROR_SIZE];
+    if (createTable((strcmp(argv[1], "-") == 0) ? NULL : argv[1], &pert, err) != CHEM_OK) {
+        printf("Unable to load the periodic table %s\n", argv[1]);
+        return -1;
+    }
+    int count = (argc >= 3) ? atoi(argv[2]) : BENCH_COUNT;
+    if (count < 1) count = BENCH_COUNT;
+
+    printf("%-10s %-14s %12s %10s %10s %10s\n", "workload", "function", "formulas/s", "MB/s", "allocs", "peakKB");
+    for (int k = 0; k < KINDS; k++) {
+        if (argc >= 4 && strcmp(argv[3], kindNames[k]) != 0)
+            continue;
+        benchKind(k, count, pert);
+    }
+
+    freeTable(pert);
+    return 0;
+}
+#endif
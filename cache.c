@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "hash.h"
+
+/**
+ * @brief Creates an empty cache.
+ *
+ * @param size The maximum number of entries (1 to CACHE_MAX).
+ * @return CACHE* The cache, or NULL if the size is out of range or memory allocation fails.
+ */
+CACHE *createCache(int size) {
+    if (size < 1 || size > CACHE_MAX) {
+        return NULL;
+    }
+    CACHE *c = (CACHE *)calloc(1, sizeof(CACHE));
+    if (c == NULL) {
+        return NULL;
+    }
+    c->size = size;
+    c->nbuckets = 1;
+    while (c->nbuckets < size) {
+        c->nbuckets *= 2;
+    }
+    c->nbuckets *= 2; // At most half full
+    c->entries = (ENTRY *)calloc(size, sizeof(ENTRY));
+    c->buckets = (int *)malloc(c->nbuckets * sizeof(int));
+    if (c->entries == NULL || c->buckets == NULL) {
+        freeCache(c);
+        return NULL;
+    }
+    memset(c->buckets, -1, c->nbuckets * sizeof(int));
+    return c;
+}
+
+/**
+ * @brief Looks up the result of a formula.
+ *
+ * @param c The cache.
+ * @param key The formula.
+ * @param klen The length of the formula.
+ * @return const ENTRY* The entry of the formula, or NULL if it is not cached.
+ */
+const ENTRY *findCache(CACHE *c, const char *key, int klen) {
+    unsigned long h = hashBytes(HASH_START, key, klen);
+
+    for (int e = c->buckets[h & (c->nbuckets - 1)]; e >= 0; e = c->entries[e].next) {
+        ENTRY *p = &c->entries[e];
+        if (p->hash == h && p->klen == klen && memcmp(p->key, key, klen) == 0) {
+            p->used = 1;
+            c->hits++;
+            return p;
+        }
+    }
+    c->misses++;
+    return NULL;
+}
+
+/**
+ * @brief Removes an entry from the chain of its bucket.
+ */
+static void unlinkEntry(CACHE *c, int e) {
+    int *link = &c->buckets[c->entries[e].hash & (c->nbuckets - 1)];
+    while (*link != e) {
+        link = &c->entries[*link].next;
+    }
+    *link = c->entries[e].next;
+}
+
+/**
+ * @brief Stores the result of a formula, evicting an entry if the cache is full.
+ *
+ * Results longer than `CACHE_VALUE_MAX` bytes are not stored.
+ *
+ * @param c The cache.
+ * @param key The formula.
+ * @param klen The length of the formula.
+ * @param value The output of the formula.
+ * @param vlen The length of the output.
+ */
+void addCache(CACHE *c, const char *key, int klen, const char *value, int vlen) {
+    int e;
+
+    if (vlen > CACHE_VALUE_MAX || klen > CACHE_VALUE_MAX) {
+        return;
+    }
+    char *copy = (char *)malloc(klen + vlen); // The formula followed by its output
+    if (copy == NULL) {
+        return;
+    }
+    memcpy(copy, key, klen);
+    memcpy(copy + klen, value, vlen);
+
+    if (c->count < c->size) {
+        e = c->count++;
+    } else {
+        // Advance the hand, giving recently used entries a second chance
+        while (c->entries[c->hand].used) {
+            c->entries[c->hand].used = 0;
+            c->hand = (c->hand + 1) % c->size;
+        }
+        e = c->hand;
+        c->hand = (c->hand + 1) % c->size;
+        unlinkEntry(c, e);
+        free(c->entries[e].key);
+        c->evictions++;
+    }
+
+    ENTRY *p = &c->entries[e];
+    p->key = copy;
+    p->klen = klen;
+    p->value = copy + klen;
+    p->vlen = vlen;
+    p->hash = hashBytes(HASH_START, key, klen);
+    p->used = 0;
+
+    int *bucket = &c->buckets[p->hash & (c->nbuckets - 1)];
+    p->next = *bucket;
+    *bucket = e;
+}
+
+/**
+ * @brief Releases the cache.
+ */
+void freeCache(CACHE *c) {
+    if (c == NULL) return;
+    if (c->entries != NULL) {
+        for (int e = 0; e < c->count; e++) {
+            free(c->entries[e].key);
+        }
+    }
+    free(c->entries);
+    free(c->buckets);
+    free(c);
+}
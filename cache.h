@@ -0,0 +1,47 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <limits.h>
+
+#define CACHE_VALUE_MAX 4096  ///< Results longer than this are not cached
+#define CACHE_MAX (INT_MAX / 4) ///< Most entries of a cache, so its bucket count fits in an int
+
+/**
+ * @brief One cached result.
+ */
+typedef struct {
+    char *key;           ///< The formula (not null-terminated)
+    int klen;            ///< Length of the formula
+    char *value;         ///< The output of the formula
+    int vlen;            ///< Length of the output
+    unsigned long hash;  ///< Hash of the formula
+    int next;            ///< Next entry of the same bucket, or -1
+    int used;            ///< Second-chance bit for the CLOCK eviction
+} ENTRY;
+
+/**
+ * @brief Bounded hash cache of formula results.
+ *
+ * It holds at most `size` entries; once it is full, entries are evicted with
+ * the CLOCK (second chance) policy, which approximates least-recently-used.
+ */
+typedef struct {
+    ENTRY *entries;      ///< The entries
+    int size;            ///< Maximum number of entries
+    int count;           ///< Number of entries in use
+    int *buckets;        ///< First entry of every bucket, or -1
+    int nbuckets;        ///< Number of buckets (a power of 2)
+    int hand;            ///< Position of the CLOCK hand
+    long hits;           ///< Number of lookups that found the formula
+    long misses;         ///< Number of lookups that did not
+    long evictions;      ///< Number of entries that were replaced
+} CACHE;
+
+
+CACHE *createCache(int size);
+const ENTRY *findCache(CACHE *c, const char *key, int klen);
+void addCache(CACHE *c, const char *key, int klen, const char *value, int vlen);
+void freeCache(CACHE *c);
+
+#endif // CACHE_H
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "checkpoint.h"
+
+/**
+ * @brief Records the progress of a run in the checkpoint file.
+ *
+ * The checkpoint is written to a temporary file that then replaces the old one, so
+ * a run that is killed while saving leaves the previous checkpoint in place. The
+ * file holds key=value lines: mode, input, line and output.
+ *
+ * @param path The checkpoint file.
+ * @param c The progress of the run.
+ * @return int Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be written (see errno).
+ */
+int saveCheckpoint(const char *path, const CHECKPOINT *c) {
+    char temp[strlen(path) + 5];
+    sprintf(temp, "%s.tmp", path);
+
+    FILE *f = fopen(temp, "w");
+    if (f == NULL) {
+        return EXIT_FAILURE;
+    }
+    fprintf(f, "mode=%s\ninput=%zu\nline=%d\noutput=%zu\n", c->mode, c->input, c->line, c->output);
+    if (fclose(f) != 0 || rename(temp, path) != 0) {
+        remove(temp);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads the progress of an earlier run from a checkpoint file.
+ *
+ * @param path The checkpoint file.
+ * @param c Receives the progress of the run.
+ * @return int 1 if the checkpoint was read, 0 if there is no checkpoint file, or -1 if
+ *         it cannot be read (see errno) or is not a checkpoint.
+ */
+int loadCheckpoint(const char *path, CHECKPOINT *c) {
+    char line[CHECKPOINT_MODE + 32];
+    int found = 0; // One bit per key
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    memset(c, 0, sizeof(CHECKPOINT));
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (strncmp(line, "mode=", 5) == 0 && strlen(line + 5) < CHECKPOINT_MODE) {
+            strcpy(c->mode, line + 5);
+            found |= 1;
+        } else if (sscanf(line, "input=%zu", &c->input) == 1) {
+            found |= 2;
+        } else if (sscanf(line, "line=%d", &c->line) == 1 && c->line > 0) {
+            found |= 4;
+        } else if (sscanf(line, "output=%zu", &c->output) == 1) {
+            found |= 8;
+        }
+    }
+    fclose(f);
+    if (found != 15) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+
+#define CHECKPOINT_SECONDS 60   ///< Default time between two checkpoints of a run
+#define CHECKPOINT_MODE 128     ///< Longest description of the mode of a run
+
+/**
+ * @brief How far a run over an input file had got.
+ *
+ * The output file holds exactly the results of the formulas before `input`, so a
+ * run that stops can continue from there: the output is cut back to `output`
+ * bytes and the formulas are read again from byte `input`, as line `line`.
+ */
+typedef struct {
+    size_t input;           ///< Bytes of the input file that have been processed
+    int line;               ///< Line number of the next formula
+    size_t output;          ///< Bytes of the output file that belong to those formulas
+    char mode[CHECKPOINT_MODE]; ///< The options that shape the output, which a resumed run must repeat
+} CHECKPOINT;
+
+
+int saveCheckpoint(const char *path, const CHECKPOINT *c);
+int loadCheckpoint(const char *path, CHECKPOINT *c);
+
+#endif // CHECKPOINT_H
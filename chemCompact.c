@@ -0,0 +1,524 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "chemCompact.h"
+#include "chemCount.h"
+#include "chemExt.h"
+#include "parenthesisBal.h"
+#include "stack.h"
+
+/**
+ * @brief An element symbol of the formula together with the number of atoms it stands for.
+ */
+typedef struct {
+    const char *sym;    ///< The element symbol (inside the formula)
+    int len;            ///< Length of the symbol
+    long long count;    ///< Number of atoms
+} SYMRUN;
+
+/**
+ * @brief Checks if two symbols are the same.
+ */
+static int sameSymbol(const char *a, int alen, const char *b, int blen) {
+    return alen == blen && memcmp(a, b, alen) == 0;
+}
+
+/**
+ * @brief Writes a `symbol count` pair, separated from the previous one by a space.
+ */
+static void writeRun(WRITER *out, const SYMRUN *run, int first) {
+    if (!first) {
+        writeChar(out, ' ');
+    }
+    writeBytes(out, run->sym, run->len);
+    writeChar(out, ' ');
+    writeInt(out, run->count);
+}
+
+/**
+ * @brief The runs of a piece of the expansion, summarized so that pieces can be joined in constant time.
+ *
+ * Only the first and last runs are kept, since they are the ones that can merge
+ * with the runs of the neighbouring pieces; the runs in between only count as bytes.
+ */
+typedef struct {
+    long long runs;         ///< Number of runs (0 if the piece has no atoms)
+    SYMRUN first;           ///< The first run
+    SYMRUN last;            ///< The last run (the same as `first` when there is one run)
+    size_t inner;           ///< Bytes of the runs between them, each with the space before it
+} RUNSEQ;
+
+/**
+ * @brief The runs of a group with its multiplier, found by `measureRuns` for `compactChem`.
+ */
+typedef struct {
+    int end;                ///< Position of the ')' of the group
+    SYMRUN run;             ///< The only run of the group, a count of 0 if it has no atoms, or -1 if it has several runs
+} GROUPRUN;
+
+/**
+ * @brief Bytes of a `symbol count` pair.
+ */
+static size_t runBytes(const SYMRUN *run) {
+    size_t n = run->len + 2;
+    for (unsigned long long u = run->count; u >= 10; u /= 10) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Bytes of the runs of a piece, with the spaces between them.
+ *
+ * @return int EXIT_SUCCESS, or CHEM_OVERFLOW if they do not fit in a size_t.
+ */
+static int seqBytes(const RUNSEQ *s, size_t *bytes) {
+    *bytes = (s->runs == 0) ? 0 : runBytes(&s->first);
+    if (s->runs >= 2 && (__builtin_add_overflow(*bytes, s->inner, bytes) ||
+                         __builtin_add_overflow(*bytes, 1 + runBytes(&s->last), bytes))) {
+        return CHEM_OVERFLOW;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Summarizes the runs of piece `a` followed by piece `b`.
+ *
+ * The last run of `a` and the first run of `b` become one run when they have the
+ * same symbol. `into` may be `a` or `b`.
+ *
+ * @return int EXIT_SUCCESS, or CHEM_OVERFLOW if a count or the bytes do not fit in 64 bits.
+ */
+static int joinRuns(const RUNSEQ *a, const RUNSEQ *b, RUNSEQ *into) {
+    RUNSEQ r;
+    int overflow = 0;
+
+    if (a->runs == 0 || b->runs == 0) {
+        *into = (a->runs == 0) ? *b : *a;
+        return EXIT_SUCCESS;
+    }
+    r.first = a->first;
+    r.last = b->last;
+    if (sameSymbol(a->last.sym, a->last.len, b->first.sym, b->first.len)) {
+        SYMRUN merged = a->last;
+        overflow |= __builtin_add_overflow(a->last.count, b->first.count, &merged.count);
+        r.runs = a->runs + b->runs - 1;
+        r.first = (a->runs == 1) ? merged : a->first;
+        r.last = (b->runs == 1) ? merged : b->last;
+        r.inner = 0;
+        if (a->runs >= 2) {
+            r.inner = a->inner;
+        }
+        if (a->runs >= 2 && b->runs >= 2) {
+            overflow |= __builtin_add_overflow(r.inner, 1 + runBytes(&merged), &r.inner);
+        }
+        if (b->runs >= 2) {
+            overflow |= __builtin_add_overflow(r.inner, b->inner, &r.inner);
+        }
+    } else {
+        overflow |= __builtin_add_overflow(a->runs, b->runs, &r.runs);
+        r.inner = 0;
+        if (a->runs >= 2) {
+            overflow |= __builtin_add_overflow(a->inner, 1 + runBytes(&a->last), &r.inner);
+        }
+        if (b->runs >= 2) {
+            overflow |= __builtin_add_overflow(r.inner, 1 + runBytes(&b->first), &r.inner) ||
+                        __builtin_add_overflow(r.inner, b->inner, &r.inner);
+        }
+    }
+    *into = r;
+    return overflow ? CHEM_OVERFLOW : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Summarizes the runs of `count` copies of a piece, by repeated doubling.
+ *
+ * @return int EXIT_SUCCESS, or CHEM_OVERFLOW if a count or the bytes do not fit in 64 bits.
+ */
+static int repeatRuns(const RUNSEQ *s, long long count, RUNSEQ *into) {
+    RUNSEQ base = *s, r = { 0 };
+
+    while (count > 0) {
+        if ((count & 1) && joinRuns(&r, &base, &r) != EXIT_SUCCESS) {
+            return CHEM_OVERFLOW;
+        }
+        count >>= 1;
+        if (count > 0 && joinRuns(&base, &base, &base) != EXIT_SUCCESS) {
+            return CHEM_OVERFLOW;
+        }
+    }
+    *into = r;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Finds the runs of a formula without expanding it.
+ *
+ * The formula is walked once. Every element is a piece of one run, a group is the
+ * join of its pieces repeated by its multiplier (in a logarithmic number of joins),
+ * and the pieces of the open groups are kept in an array that grows past
+ * `STACK_INLINE` groups. The cost depends on the length of the formula only.
+ *
+ * @param chem The chemical formula.
+ * @param length The length of the formula.
+ * @param groups NULL, or an array of `length` entries; the entry of every '(' receives the
+ *        end of its group and, if the group is a single run, that run.
+ * @param bytes Receives the length of the runs written by `compactChem`.
+ * @return int Returns EXIT_SUCCESS, EXIT_FAILURE if the parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a count or the length does not fit in 64 bits, or CHEM_NO_MEMORY.
+ */
+static int measureRuns(const char *chem, int length, GROUPRUN *groups, size_t *bytes) {
+    RUNSEQ local[STACK_INLINE], *seq = local; // The pieces of the formula and of every open group
+    int open[STACK_INLINE], *opens = open;    // Positions of the '(' of the open groups
+    int depth = 0, capacity = STACK_INLINE;
+    int flag = EXIT_SUCCESS;
+
+    memset(&seq[0], 0, sizeof(RUNSEQ));
+    for (int i = 0; i < length && flag == EXIT_SUCCESS; i++) {
+        char c = chem[i];
+
+        if (c >= 'A' && c <= 'Z') {
+            RUNSEQ atom = { 1, { &chem[i], 1, 0 }, { &chem[i], 1, 0 }, 0 };
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+                atom.first.len++;
+            }
+            atom.first.count = readMultiplier(chem, length, &i);
+            atom.last = atom.first;
+            if (atom.first.count < 0) {
+                flag = CHEM_OVERFLOW;
+            } else if (atom.first.count > 0) {
+                flag = joinRuns(&seq[depth], &atom, &seq[depth]);
+            }
+        } else if (c == '(') {
+            if (depth + 1 == capacity) {
+                RUNSEQ *p = (RUNSEQ *)malloc(2 * capacity * sizeof(RUNSEQ));
+                int *q = (int *)malloc(2 * capacity * sizeof(int));
+                if (p == NULL || q == NULL) {
+                    free(p);
+                    free(q);
+                    flag = CHEM_NO_MEMORY;
+                    break;
+                }
+                memcpy(p, seq, capacity * sizeof(RUNSEQ));
+                memcpy(q, opens, capacity * sizeof(int));
+                if (seq != local) {
+                    free(seq);
+                    free(opens);
+                }
+                seq = p;
+                opens = q;
+                capacity *= 2;
+            }
+            opens[depth++] = i;
+            memset(&seq[depth], 0, sizeof(RUNSEQ));
+        } else if (c == ')') {
+            if (depth == 0) {
+                flag = EXIT_FAILURE; // No matching '('
+                break;
+            }
+            int end = i;
+            long long count = readMultiplier(chem, length, &i);
+            RUNSEQ group;
+            if (count < 0 || repeatRuns(&seq[depth], count, &group) != EXIT_SUCCESS) {
+                flag = CHEM_OVERFLOW;
+                break;
+            }
+            depth--;
+            if (groups != NULL) {
+                groups[opens[depth]].end = end;
+                groups[opens[depth]].run = group.first;
+                groups[opens[depth]].run.count = (group.runs == 0) ? 0 : (group.runs == 1) ? group.first.count : -1;
+            }
+            flag = joinRuns(&seq[depth], &group, &seq[depth]);
+        }
+    }
+    if (flag == EXIT_SUCCESS && depth > 0) {
+        flag = EXIT_FAILURE; // Unmatched '('
+    }
+    if (flag == EXIT_SUCCESS) {
+        flag = seqBytes(&seq[0], bytes);
+    }
+    if (seq != local) {
+        free(seq);
+        free(opens);
+    }
+    return flag;
+}
+
+/**
+ * @brief Computes the length of the runs of a formula, without writing them.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param bytes Receives the length of the runs written by `compactChem` (without a newline).
+ * @return int Returns EXIT_SUCCESS, EXIT_FAILURE if parentheses are unbalanced, CHEM_OVERFLOW
+ *         if a count or the length does not fit in 64 bits, or CHEM_NO_MEMORY.
+ */
+int compactSize(const char * const chem, int length, size_t *bytes) {
+    return measureRuns(chem, length, NULL, bytes);
+}
+
+/**
+ * @brief Writes the extended version of a formula as runs of `symbol count` pairs.
+ *
+ * The formula is expanded in order, like `extenedChem` does, but consecutive atoms
+ * of the same element are written as one run: `(CH2)2` becomes `C 1 H 2 C 1 H 2` and
+ * `H2(H)3` becomes `H 5`. The runs are written while the formula is parsed, so the
+ * expanded string is never built.
+ *
+ * The runs of every group are found first with `measureRuns`. A group that is a single
+ * run (`((H)100000)100000` is `H 10000000000`) or has no atoms is written or skipped in
+ * one step; the others are walked again for every repetition, using a stack of (start
+ * of the group, repetitions left) frames, so the time depends on the length of the runs.
+ * A group that alternates between elements has a run per atom, and since `H 1 O 1` is
+ * longer than `H O` its runs can be longer than the extended version; like the extended
+ * version, they are limited to 2GB.
+ *
+ * Nothing is written if the parentheses are unbalanced or the formula is too large.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param out The writer that receives the runs (without a newline).
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if the runs would be longer than INT_MAX bytes, or CHEM_NO_MEMORY.
+ */
+int compactChem(const char * const chem, int length, WRITER *out) {
+    GROUPRUN *groups = NULL;
+    size_t bytes;
+    int start;
+
+    if (memchr(chem, '(', length) != NULL) {
+        groups = (GROUPRUN *)malloc(length * sizeof(GROUPRUN));
+        if (groups == NULL) {
+            return CHEM_NO_MEMORY;
+        }
+    }
+    int flag = measureRuns(chem, length, groups, &bytes);
+    if (flag == EXIT_SUCCESS && bytes > INT_MAX) {
+        flag = CHEM_OVERFLOW; // Every walked repetition writes a run, so this also bounds the time
+    }
+    if (flag != EXIT_SUCCESS) {
+        free(groups);
+        return flag;
+    }
+
+    SYMRUN run = { NULL, 0, 0 }; // The run that is being built
+    int first = 1;
+    STACK stack;
+    STACK *frames = &stack; // Start and repetitions left of every group being expanded
+    setupStack(frames);
+
+    for (int i = 0; i < length; i++) {
+        char c = chem[i];
+        SYMRUN next;
+
+        // If character is uppercase, it's the start of a new element
+        if (c >= 'A' && c <= 'Z') {
+            start = i;
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+            }
+            next.sym = &chem[start];
+            next.len = i - start + 1;
+            next.count = readMultiplier(chem, length, &i);
+        }
+        // Opening parenthesis: a group of one run is written like an element, the others are walked once per repetition
+        else if (c == '(') {
+            const GROUPRUN *g = &groups[i];
+            if (g->run.count >= 0) {
+                next = g->run;
+                i = g->end;
+                readMultiplier(chem, length, &i); // Skip the multiplier
+            } else {
+                int end = g->end;
+                int count = (int)readMultiplier(chem, length, &end); // At most one per run
+                if (pushINT(i, frames) == EXIT_FAILURE || pushINT(count - 1, frames) == EXIT_FAILURE) {
+                    clearStack(frames);
+                    free(groups);
+                    return CHEM_NO_MEMORY;
+                }
+                continue;
+            }
+        }
+        // Closing parenthesis: walk the group again, or leave it
+        else if (c == ')') {
+            int *left = top(frames); // The frame is the top two entries: start, repetitions left
+            if (*left > 0) {
+                (*left)--;
+                i = left[-1];
+            } else {
+                popINT(frames, &start);
+                popINT(frames, &start);
+                readMultiplier(chem, length, &i); // Skip the multiplier
+            }
+            continue;
+        } else {
+            continue;
+        }
+
+        if (next.count == 0) {
+            continue; // No atoms
+        }
+        if (!sameSymbol(run.sym, run.len, next.sym, next.len)) {
+            if (run.count > 0) {
+                writeRun(out, &run, first);
+                first = 0;
+            }
+            run = next;
+        } else {
+            run.count += next.count;
+        }
+    }
+    if (run.count > 0) {
+        writeRun(out, &run, first);
+    }
+
+    clearStack(frames);
+    free(groups);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Orders two runs alphabetically by symbol.
+ */
+static int symbolOrder(const void *a, const void *b) {
+    const SYMRUN *x = (const SYMRUN *)a;
+    const SYMRUN *y = (const SYMRUN *)b;
+    int k = (x->len < y->len) ? x->len : y->len;
+    int cmp = memcmp(x->sym, y->sym, k);
+    return (cmp != 0) ? cmp : x->len - y->len;
+}
+
+/**
+ * @brief Writes the composition of a formula as `symbol count` pairs in Hill order.
+ *
+ * The atoms of every element are added up, and the elements are written with
+ * carbon first, hydrogen second and the rest in alphabetical order; without
+ * carbon, all the elements (hydrogen too) are in alphabetical order. For
+ * example `CH3COOH` becomes `C 2 H 4 O 2`. Like `countChem`, the group counts are
+ * multiplied out on the raw formula, so no expanded string is built.
+ *
+ * Nothing is written if the parentheses are unbalanced or a total does not fit in 64 bits.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param out The writer that receives the pairs (without a newline).
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a multiplier or a total does not fit in 64 bits, or CHEM_NO_MEMORY.
+ */
+int hillChem(const char * const chem, int length, WRITER *out) {
+    int flag = EXIT_SUCCESS;
+    int r = 0; // Number of element tokens seen so far
+    int first;
+
+    SYMRUN *runs = (SYMRUN *)malloc((length + 1) * sizeof(SYMRUN));
+    if (runs == NULL) {
+        return CHEM_NO_MEMORY;
+    }
+    STACK stack;
+    STACK *groups = &stack; // Stack of the first token index of every open group
+    setupStack(groups);
+
+    for (int i = 0; i < length; i++) {
+        char c = chem[i];
+
+        // If character is uppercase, it's the start of a new element
+        if (c >= 'A' && c <= 'Z') {
+            int start = i;
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+            }
+            runs[r].sym = &chem[start];
+            runs[r].len = i - start + 1;
+            runs[r].count = readMultiplier(chem, length, &i);
+            if (runs[r].count < 0) {
+                flag = CHEM_OVERFLOW;
+                break;
+            }
+            r++;
+        }
+        // Opening parenthesis: remember where the group starts
+        else if (c == '(') {
+            if (pushINT(r, groups) == EXIT_FAILURE) {
+                flag = CHEM_NO_MEMORY;
+                break;
+            }
+        }
+        // Closing parenthesis: multiply every token of the group
+        else if (c == ')') {
+            if (isEmpty(groups)) {
+                flag = EXIT_FAILURE; // No matching '('
+                break;
+            }
+            popINT(groups, &first);
+            long long count = readMultiplier(chem, length, &i);
+            for (int k = first; k < r; k++) {
+                if (count < 0 || __builtin_mul_overflow(runs[k].count, count, &runs[k].count)) {
+                    flag = CHEM_OVERFLOW;
+                }
+            }
+            if (flag == CHEM_OVERFLOW)
+                break;
+        }
+    }
+
+    // If stack is not empty, there are unmatched parentheses
+    if (flag == EXIT_SUCCESS && !isEmpty(groups)) {
+        flag = EXIT_FAILURE;
+    }
+    clearStack(groups);
+
+    if (flag == EXIT_SUCCESS) {
+        qsort(runs, r, sizeof(SYMRUN), symbolOrder);
+
+        // Add up the runs of the same element
+        int n = 0;
+        for (int k = 0; k < r; k++) {
+            if (n > 0 && sameSymbol(runs[n - 1].sym, runs[n - 1].len, runs[k].sym, runs[k].len)) {
+                if (__builtin_add_overflow(runs[n - 1].count, runs[k].count, &runs[n - 1].count)) {
+                    flag = CHEM_OVERFLOW;
+                }
+            } else {
+                runs[n++] = runs[k];
+            }
+        }
+
+        // Find carbon and hydrogen, which go first if there is carbon
+        int carbon = -1, hydrogen = -1;
+        for (int k = 0; k < n; k++) {
+            if (runs[k].len == 1 && runs[k].count > 0) {
+                if (runs[k].sym[0] == 'C') carbon = k;
+                if (runs[k].sym[0] == 'H') hydrogen = k;
+            }
+        }
+        if (carbon < 0) {
+            hydrogen = -1; // Without carbon, hydrogen is in alphabetical order
+        }
+
+        // Write the elements that have atoms
+        if (flag == EXIT_SUCCESS) {
+            first = 1;
+            if (carbon >= 0) {
+                writeRun(out, &runs[carbon], first);
+                first = 0;
+            }
+            if (hydrogen >= 0) {
+                writeRun(out, &runs[hydrogen], first);
+                first = 0;
+            }
+            for (int k = 0; k < n; k++) {
+                if (runs[k].count > 0 && k != carbon && k != hydrogen) {
+                    writeRun(out, &runs[k], first);
+                    first = 0;
+                }
+            }
+        }
+    }
+
+    free(runs);
+    return flag;
+}
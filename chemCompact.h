@@ -0,0 +1,11 @@
+#ifndef CHEM_COMPACT
+#define CHEM_COMPACT
+
+#include "writer.h"
+
+
+int compactSize(const char * const chem, int length, size_t *bytes);
+int compactChem(const char * const chem, int length, WRITER *out);
+int hillChem(const char * const chem, int length, WRITER *out);
+
+#endif // CHEM_COMPACT
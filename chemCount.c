@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "periodicTable.h"
+#include "chemCount.h"
+#include "writer.h"
+#include "stack.h"
+
+/**
+ * @brief One element token of the formula together with its current multiplicity.
+ */
+typedef struct {
+    int slot;         ///< Index of the element in the `PTABLE`, or -1 if it was not found
+    long long count;  ///< Number of atoms this token stands for
+    int at;           ///< Position of the element symbol in the formula
+    int len;          ///< Length of the element symbol
+} ATOMRUN;
+
+/**
+ * @brief Reads the multiplier that follows position `*i`.
+ *
+ * The multiplier is the whole run of digits after an element or a ')', of any
+ * length. A multiplier of `0` stands for no atoms at all.
+ *
+ * @param chem The chemical formula.
+ * @param length The length of the formula.
+ * @param i Pointer to the current position; moved past the digits that were read.
+ * @return long long The multiplier, 1 if no multiplier follows, or -1 if it does not fit in 64 bits.
+ */
+long long readMultiplier(const char *chem, int length, int *i) {
+    long long count = 1;
+
+    if (*i + 1 < length && chem[*i + 1] >= '0' && chem[*i + 1] <= '9') {
+        count = 0;
+        while (*i + 1 < length && chem[*i + 1] >= '0' && chem[*i + 1] <= '9') {
+            int digit = chem[++(*i)] - '0';
+            if (count < 0 || count > (LLONG_MAX - digit) / 10) {
+                count = -1; // Too large, keep skipping the digits
+            } else {
+                count = count * 10 + digit;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Copies the (at most two character) element symbol into `ch` for error messages.
+ *
+ * @param sym The start of the element symbol.
+ * @param len The length of the element symbol.
+ * @param ch Buffer of 3 bytes that receives the symbol.
+ */
+static void copySymbol(const char *sym, int len, char ch[3]) {
+    int k = (len < 2) ? len : 2;
+    memcpy(ch, sym, k);
+    ch[k] = '\0';
+}
+
+/**
+ * @brief Remembers the composition of a group body that has just been parsed.
+ *
+ * Groups that contain an unknown element are not remembered, since their error
+ * messages need the symbols from the formula.
+ *
+ * @param memo The memo.
+ * @param body The text between '(' and ')'.
+ * @param len The length of the body.
+ * @param runs The element tokens of one copy of the group.
+ * @param n The number of tokens.
+ * @param pert Pointer to the periodic table.
+ */
+static void rememberGroup(GROUPMEMO *memo, const char *body, int len, const ATOMRUN *runs, int n, const PTABLE * const pert) {
+    long long sum = 0;
+    long long atoms;
+
+    for (int k = 0; k < n; k++) {
+        if (runs[k].slot < 0)
+            return;
+        if (__builtin_mul_overflow(runs[k].count, (long long)pert->anum[runs[k].slot], &atoms) ||
+            __builtin_add_overflow(sum, atoms, &sum))
+            return; // The total does not fit, `protonChem` reports it
+    }
+
+    MEMO *e = addMemo(memo, body, len, sum, n);
+    if (e != NULL) {
+        for (int k = 0; k < n; k++) {
+            e->atoms[k].slot = runs[k].slot;
+            e->atoms[k].count = runs[k].count;
+        }
+    }
+}
+
+/**
+ * @brief Computes the element count vector of a chemical formula.
+ *
+ * The formula is walked once. Every element symbol is recorded together with its
+ * multiplier, and when a group is closed with ')' the counts of all the tokens
+ * inside it are multiplied by the group multiplier. No expanded string is built,
+ * so the cost depends on the length of the formula and not on its expanded size.
+ *
+ * With a memo, the composition of every group body is remembered, and a group whose
+ * body has been seen before (in this formula or an earlier one) is not parsed again.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param counts Array of `N` integers that receives the number of atoms of each element.
+ * @param pert Pointer to a constant `PTABLE` structure containing periodic table data.
+ * @param memo The compositions of the groups seen so far, or NULL.
+ * @param out The writer that receives the error messages for unknown elements (one per symbol
+ *        of the formula, with its number of atoms when it is not 1), or NULL.
+ * @param scratch NULL, or a buffer for the element tokens that is kept from one call to the
+ *        next (it starts as NULL and is grown as needed; the caller frees it).
+ * @param scratchSize Pointer to the size of `*scratch`.
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a count does not fit in 64 bits, CHEM_NO_MEMORY, or, without a
+ *         writer, CHEM_UNKNOWN if an element is not in the table (the other counts are filled).
+ */
+int countChem(const char * const chem, int length, long long counts[N], const PTABLE * const pert, GROUPMEMO *memo, WRITER *out,
+              void **scratch, size_t *scratchSize) {
+    int flag = EXIT_SUCCESS;
+    int r = 0; // Number of element tokens seen so far
+    int start, first;
+    char ch[3];
+
+    memset(counts, 0, N * sizeof(long long));
+
+    // With a memo, find the group bodies first so that repeated ones can be skipped
+    if (memo != NULL && memchr(chem, '(', length) != NULL) {
+        flag = matchGroups(memo, chem, length);
+        if (flag == EXIT_FAILURE)
+            return EXIT_FAILURE; // Unbalanced
+        if (flag != EXIT_SUCCESS)
+            memo = NULL; // Out of memory, parse without the memo
+        flag = EXIT_SUCCESS;
+    } else {
+        memo = NULL;
+    }
+
+    ATOMRUN *runs;
+    size_t size = (length + 1) * sizeof(ATOMRUN);
+    if (scratch == NULL) {
+        runs = (ATOMRUN *)malloc(size);
+    } else if (size > *scratchSize) {
+        runs = (ATOMRUN *)realloc(*scratch, size);
+        if (runs != NULL) {
+            *scratch = runs;
+            *scratchSize = size;
+        }
+    } else {
+        runs = (ATOMRUN *)*scratch;
+    }
+    if (runs == NULL) {
+        return CHEM_NO_MEMORY;
+    }
+    STACK stack;
+    STACK *groups = &stack; // Stack of the first token index and position of every open group
+    setupStack(groups);
+
+    for (int i = 0; i < length; i++) {
+        char c = chem[i];
+
+        // If character is uppercase, it's the start of a new element
+        if (c >= 'A' && c <= 'Z') {
+            start = i;
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+            }
+            runs[r].slot = findElement(pert, &chem[start], i - start + 1);
+            runs[r].at = start;
+            runs[r].len = i - start + 1;
+            runs[r].count = readMultiplier(chem, length, &i);
+            if (runs[r].count < 0) {
+                flag = CHEM_OVERFLOW;
+                break;
+            }
+            r++;
+        }
+        // Opening parenthesis: remember where the group starts
+        else if (c == '(') {
+            int end = (memo != NULL) ? memo->match[i] : 0;
+            if (end - i - 1 >= MEMO_MIN_BODY) {
+                const MEMO *e = findMemo(memo, &chem[i + 1], end - i - 1);
+                if (e != NULL && e->natoms >= 0) {
+                    memo->hits++;
+                    // Skip the body, its composition is known
+                    i = end;
+                    long long count = readMultiplier(chem, length, &i);
+                    for (int k = 0; k < e->natoms; k++, r++) {
+                        runs[r].slot = e->atoms[k].slot;
+                        if (count < 0 || __builtin_mul_overflow(e->atoms[k].count, count, &runs[r].count)) {
+                            flag = CHEM_OVERFLOW;
+                        }
+                    }
+                    if (flag == CHEM_OVERFLOW)
+                        break;
+                    continue;
+                }
+            }
+            if (pushINT(r, groups) == EXIT_FAILURE || pushINT(i, groups) == EXIT_FAILURE) {
+                flag = CHEM_NO_MEMORY;
+                break;
+            }
+        }
+        // Closing parenthesis: multiply every token of the group
+        else if (c == ')') {
+            if (isEmpty(groups)) {
+                flag = EXIT_FAILURE; // No matching '('
+                break;
+            }
+            popINT(groups, &first);
+            popINT(groups, &start);
+            if (memo != NULL && i - first - 1 >= MEMO_MIN_BODY) {
+                rememberGroup(memo, &chem[first + 1], i - first - 1, &runs[start], r - start, pert);
+            }
+            long long count = readMultiplier(chem, length, &i);
+            for (int k = start; k < r; k++) {
+                if (count < 0 || __builtin_mul_overflow(runs[k].count, count, &runs[k].count)) {
+                    flag = CHEM_OVERFLOW;
+                }
+            }
+            if (flag == CHEM_OVERFLOW)
+                break;
+        }
+    }
+
+    // If stack is not empty, there are unmatched parentheses
+    if (flag == EXIT_SUCCESS && !isEmpty(groups)) {
+        flag = EXIT_FAILURE;
+    }
+    clearStack(groups);
+
+    // Add up the counts first, so nothing is reported if they overflow
+    for (int k = 0; flag == EXIT_SUCCESS && k < r; k++) {
+        if (runs[k].slot >= 0 && __builtin_add_overflow(counts[runs[k].slot], runs[k].count, &counts[runs[k].slot])) {
+            flag = CHEM_OVERFLOW;
+        }
+    }
+    if (flag == EXIT_SUCCESS) {
+        for (int k = 0; k < r; k++) {
+            if (runs[k].slot < 0 && runs[k].count > 0 && out == NULL) {
+                flag = CHEM_UNKNOWN; // Nowhere to report it
+                break;
+            }
+            if (runs[k].slot < 0 && runs[k].count > 0) {
+                copySymbol(&chem[runs[k].at], runs[k].len, ch);
+                writeString(out, "Element ");
+                writeString(out, ch);
+                writeString(out, " not found in periodic table");
+                if (runs[k].count != 1) {
+                    writeString(out, " (");
+                    writeInt(out, runs[k].count); // Once per token, not once per atom
+                    writeString(out, " atoms)");
+                }
+                writeString(out, ".\n");
+            }
+        }
+    }
+
+    if (scratch == NULL) {
+        free(runs);
+    }
+    return flag;
+}
@@ -0,0 +1,14 @@
+#ifndef CHEM_COUNT
+#define CHEM_COUNT
+
+#include "periodicTable.h" // Include the periodic table definition
+#include "writer.h"
+#include "groupMemo.h"
+#include "chemStatus.h"
+
+
+long long readMultiplier(const char *chem, int length, int *i);
+int countChem(const char * const chem, int length, long long counts[N], const PTABLE * const pert, GROUPMEMO *memo, WRITER *out,
+              void **scratch, size_t *scratchSize);
+
+#endif // CHEM_COUNT
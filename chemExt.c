@@ -2,8 +2,10 @@
 #include <stdbool.h> 
 #include <string.h> 
 #include <stdlib.h> 
+#include <stdint.h> 
 
 #include "chemExt.h"
+#include "chemCount.h"
 #include "stack.h"
 
 /**
@@ -11,17 +13,26 @@
  * 
  * This function takes a chemical formula string, processes it to apply multipliers and handle 
  * nested parentheses, and produces an expanded form of the formula in the provided extchem variable.
+ * Multipliers may have any number of digits; a multiplier of 0 drops the element or group.
+ * The buffer must be at least `extendedSize` bytes (its `buffer` field).
  * 
- * @param chem The original chemical formula as a string (input).
+ * @param chem The original chemical formula (input); it does not have to be null-terminated.
+ * @param length The length of the formula.
  * @param extchem A buffer where the expanded chemical formula is stored (output).
- * @return int Returns EXIT_SUCCESS if the formula is expanded correctly, or EXIT_FAILURE if parentheses are unbalanced.
+ * @return int Returns EXIT_SUCCESS if the formula is expanded correctly, EXIT_FAILURE if parentheses are unbalanced,
+ *         or CHEM_NO_MEMORY.
  */
-int extenedChem(const char * const chem, char *extchem) {
-    int length = strlen(chem); // Get the length of the input formula
-   
+int extenedChem(const char * const chem, int length, char *extchem) {
+    // An empty formula has an empty expansion
+    if (length == 0) {
+        extchem[0] = '\0';
+        return EXIT_SUCCESS;
+    }
+
     // If the formula is a single element, copy it directly to the output buffer
     if (length == 1) {
-        strcpy(extchem, chem);
+        extchem[0] = chem[0];
+        extchem[1] = '\0';
         return EXIT_SUCCESS; // Return success
     }
 
@@ -29,25 +40,30 @@ int extenedChem(const char * const chem, char *extchem) {
 
     // Loop to check if formula contains numbers or parentheses
     for (int i = 0; i < length; i++) {
-        if (((chem[i] > '0') && (chem[i] < '9')) || (chem[i] == '(') || (chem[i] == ')')) {
+        if (((chem[i] >= '0') && (chem[i] <= '9')) || (chem[i] == '(') || (chem[i] == ')')) {
             onlyLetters = false; // Set flag to false if numbers or parentheses are found
         }
     }
 
     // If formula has only letters, copy it with spaces between elements
     if (onlyLetters) {
-        strncat(extchem, &chem[0], 1);  // Add the first element to the output buffer
+        int j = 0;
+        extchem[j++] = chem[0];  // Add the first element to the output buffer
         for (int i = 1; i < length; i++) {
             if (chem[i] >= 'A' && chem[i] <= 'Z') { // Check if character is uppercase
-                strcat(extchem, " "); // Add space before new element
+                extchem[j++] = ' '; // Add space before new element
             }
-            strncat(extchem, &chem[i], 1); // Add character to output
+            extchem[j++] = chem[i]; // Add character to output
         }
+        extchem[j] = '\0';
         return EXIT_SUCCESS; // Return success
     }
 
-    STACK *stack = initStack(); // Initialize stack for parentheses
-    STACK *stackParenthJ = initStack(); // Initialize stack to track group start indices
+    STACK parens, starts;
+    STACK *stack = &parens; // Stack for parentheses
+    STACK *stackParenthJ = &starts; // Stack to track group start indices
+    setupStack(stack);
+    setupStack(stackParenthJ);
     int j = 0; // Index for the output buffer
     int parenthj = 0; // Starting index of a group in the expanded formula
     int parlength = 0; // Length of the content within parentheses
@@ -68,7 +84,7 @@ int extenedChem(const char * const chem, char *extchem) {
             chemlength = 1; // Reset chemlength for new element
 
             // Add space if next character is also uppercase (start of a new element)
-            if (chem[i + 1] >= 'A' && chem[i + 1] <= 'Z') 
+            if (i + 1 < length && chem[i + 1] >= 'A' && chem[i + 1] <= 'Z') 
                 extchem[j++] = ' ';
 
             // Check if lowercase letters follow, indicating a complete element symbol
@@ -84,14 +100,20 @@ int extenedChem(const char * const chem, char *extchem) {
 
         // If character is an opening parenthesis
         if (c == '(') {
-            pushCHAR(c, stack); // Push '(' onto stack to track it
-            pushINT(j, stackParenthJ); // Push the starting index of the group onto index stack
+            // Push '(' onto stack to track it, and the starting index of the group onto index stack
+            if (pushCHAR(c, stack) == EXIT_FAILURE || pushINT(j, stackParenthJ) == EXIT_FAILURE) {
+                clearStack(stack);
+                clearStack(stackParenthJ);
+                return CHEM_NO_MEMORY;
+            }
             parlength = 0; // Reset group length for a new group
         } 
         
         // If character is a closing parenthesis
         else if (c == ')') {
             if (isEmpty(stack)) {
+                clearStack(stack);
+                clearStack(stackParenthJ);
                 return EXIT_FAILURE; // If no matching '(', return failure
             }
 
@@ -100,17 +122,15 @@ int extenedChem(const char * const chem, char *extchem) {
             parlength = j - parenthj; // Calculate length of content inside parentheses
        
             // Check if there’s a multiplier after the ')'
-            if (i + 1 < length && chem[i + 1] >= '1' && chem[i + 1] <= '9') {
-                i++; // Move to multiplier
-                int count = chem[i] - '0'; // Convert char to int
+            if (i + 1 < length && chem[i + 1] >= '0' && chem[i + 1] <= '9') {
+                long long count = readMultiplier(chem, length, &i); // Read all the digits
 
-                // Check for two-digit multiplier
-                if (i + 1 < length && chem[i + 1] >= '0' && chem[i + 1] <= '9') {
-                    count = count * 10 + (chem[++i] - '0'); // Form two-digit multiplier
+                if (count == 0) {
+                    j = parenthj; // No copies: drop the content of the group
                 }
              
                 // Repeat the content in parentheses `count` times
-                for (int k = 1; k < count; k++) {
+                for (long long k = 1; k < count; k++) {
                     extchem[j++] = ' '; // Add space
                     for (int m = 0; m < parlength; m++) {
                         
@@ -121,12 +141,10 @@ int extenedChem(const char * const chem, char *extchem) {
         }
 
         // Handle multipliers directly following an element
-        if (i + 1 < length && chem[i + 1] >= '1' && chem[i + 1] <= '9') {
-            int count = chem[++i] - '0'; // Convert multiplier to int
-
-            // Check for two-digit multiplier
-            if (i + 1 < length && chem[i + 1] >= '0' && chem[i + 1] <= '9') {
-                count = count * 10 + (chem[++i] - '0'); // Form two-digit multiplier
+        if (i + 1 < length && chem[i + 1] >= '0' && chem[i + 1] <= '9') {
+            long long count = readMultiplier(chem, length, &i); // Read all the digits
+            if (chemlength == 0) {
+                continue; // The digits do not follow an element: skip them
             }
 int repC;
         if(chemlength>1)
@@ -135,8 +153,13 @@ int repC;
                      repC = j - chemlength ;
              // Position of the element start
 
+            if (count == 0) {
+                j = repC; // No atoms: drop the element
+                chemlength = 0;
+                continue;
+            }
             extchem[j++] = ' '; // Add space
-            for (int k = 1; k < count; k++) {
+            for (long long k = 1; k < count; k++) {
                 for (int m = 0; m < chemlength; m++) {
                     extchem[j++] = extchem[repC + m]; // Repeat the element
                 }
@@ -149,32 +172,203 @@ int repC;
 
     // If stack is not empty, there are unmatched parentheses
     if (!isEmpty(stack)) {
+        clearStack(stack);
+        clearStack(stackParenthJ);
         return EXIT_FAILURE; // Return failure if unbalanced
     }
+    clearStack(stack);
+    clearStack(stackParenthJ);
 
     extchem[j] = '\0'; // Null-terminate the expanded formula
     return EXIT_SUCCESS; // Return success
 }
 
+/**
+ * @brief Length and atoms of the expansion where a group starts, for `extendedSize`.
+ */
+typedef struct {
+    size_t j;       ///< Length of the expansion
+    size_t atoms;   ///< Atoms of the expansion
+} GROUPSTART;
+
+/**
+ * @brief Computes the exact size of the extended version of a formula, without expanding it.
+ *
+ * The formula is walked once and every step of `extenedChem` is replayed on lengths
+ * only: the symbols and separators it writes, the copies of every group and element,
+ * and the groups and elements it drops (a multiplier of 0 still writes them once, so
+ * the buffer may need more than the final length). The start of every open group is
+ * kept in an array of size_t, which grows past `STACK_INLINE` groups.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param size Receives the length of the extended formula, the buffer it needs and its atoms.
+ * @return int Returns EXIT_SUCCESS, EXIT_FAILURE if parentheses are unbalanced, CHEM_OVERFLOW
+ *         if a multiplier does not fit in 64 bits or the extended formula does not fit in
+ *         memory, or CHEM_NO_MEMORY.
+ */
+int extendedSize(const char * const chem, int length, EXTSIZE *size) {
+    size_t j = 0, peak = 0, atoms = 0; // Length, longest length so far and atoms of the expansion
+    int chemlength = 0; // Length of the current element
+    bool overflow = false;
+
+    // The shortcuts of `extenedChem`: a single character, and formulas of letters only
+    if (length <= 1) {
+        size->length = length;
+        size->buffer = length + 1;
+        size->atoms = (length == 1 && chem[0] >= 'A' && chem[0] <= 'Z');
+        return EXIT_SUCCESS;
+    }
+    bool onlyLetters = true;
+    for (int i = 0; i < length; i++) {
+        if (((chem[i] >= '0') && (chem[i] <= '9')) || (chem[i] == '(') || (chem[i] == ')')) {
+            onlyLetters = false;
+            break;
+        }
+        if (chem[i] >= 'A' && chem[i] <= 'Z') {
+            atoms++;
+        }
+    }
+    if (onlyLetters) {
+        size->atoms = atoms;
+        size->length = length + atoms - (chem[0] >= 'A' && chem[0] <= 'Z'); // A space before every element but the first
+        size->buffer = size->length + 1;
+        return EXIT_SUCCESS;
+    }
+    atoms = 0;
+
+    // Length and atoms of the expansion where every open group starts
+    GROUPSTART local[STACK_INLINE], *groups = local;
+    int depth = 0, capacity = STACK_INLINE;
+
+    for (int i = 0; i < length; i++) {
+        char c = chem[i];
+
+        if (depth == 0) {
+            chemlength = 0;
+        }
+
+        // An element: its symbol, and a separator if another element or a lowercase run follows
+        if (c >= 'A' && c <= 'Z') {
+            j++;
+            atoms++;
+            chemlength = 1;
+            if (i + 1 < length && chem[i + 1] >= 'A' && chem[i + 1] <= 'Z') {
+                j++;
+            } else if (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                    i++;
+                    j++;
+                    chemlength++;
+                }
+                j++;
+            }
+            peak = (j > peak) ? j : peak;
+        }
+
+        if (c == '(') {
+            if (depth == capacity) {
+                GROUPSTART *p = (GROUPSTART *)realloc((groups == local) ? NULL : groups, 2 * capacity * sizeof(*groups));
+                if (p == NULL) {
+                    if (groups != local) free(groups);
+                    return CHEM_NO_MEMORY;
+                }
+                if (groups == local) memcpy(p, local, sizeof(local));
+                groups = p;
+                capacity *= 2;
+            }
+            groups[depth].j = j;
+            groups[depth].atoms = atoms;
+            depth++;
+        } else if (c == ')') {
+            if (depth == 0) {
+                if (groups != local) free(groups);
+                return EXIT_FAILURE; // No matching '('
+            }
+            depth--;
+            if (i + 1 < length && chem[i + 1] >= '0' && chem[i + 1] <= '9') {
+                long long count = readMultiplier(chem, length, &i);
+                size_t parlength = j - groups[depth].j, copies, inside = atoms - groups[depth].atoms;
+                if (count < 0) {
+                    overflow = true;
+                } else if (count == 0) {
+                    j = groups[depth].j; // The group is dropped
+                    atoms = groups[depth].atoms;
+                } else {
+                    // Every other copy is a separator and the content of the group
+                    overflow |= __builtin_mul_overflow(parlength + 1, (size_t)count - 1, &copies) ||
+                                __builtin_add_overflow(j, copies, &j) ||
+                                __builtin_mul_overflow(inside, (size_t)count - 1, &copies) ||
+                                __builtin_add_overflow(atoms, copies, &atoms);
+                    peak = (j > peak) ? j : peak;
+                }
+            }
+        }
+
+        // A multiplier after an element: a separator, and every other copy with its separator
+        if (i + 1 < length && chem[i + 1] >= '0' && chem[i + 1] <= '9') {
+            long long count = readMultiplier(chem, length, &i);
+            if (chemlength == 0) {
+                continue; // The digits do not follow an element: they are skipped
+            }
+            if (count < 0) {
+                overflow = true;
+            } else if (count == 0) {
+                j -= chemlength + (chemlength > 1); // The element is dropped
+                atoms--;
+                chemlength = 0;
+                continue;
+            } else {
+                size_t copies;
+                overflow |= __builtin_mul_overflow((size_t)chemlength + 1, (size_t)count - 1, &copies) ||
+                            __builtin_add_overflow(j, copies, &j) ||
+                            __builtin_add_overflow(j, 1, &j) ||
+                            __builtin_add_overflow(atoms, (size_t)count - 1, &atoms);
+                peak = (j > peak) ? j : peak;
+            }
+        }
+
+        chemlength = 0;
+    }
+
+    // After an overflow the lengths are meaningless, but the walk still finds unbalanced parentheses
+    if (groups != local) free(groups);
+    if (depth > 0) {
+        return EXIT_FAILURE; // Unmatched '('
+    }
+    if (overflow || peak == SIZE_MAX) {
+        return CHEM_OVERFLOW;
+    }
+    size->length = j;
+    size->buffer = peak + 1;
+    size->atoms = atoms;
+    return EXIT_SUCCESS;
+}
+
 #ifdef DEBUG2
+#include <limits.h>
+#include "reader.h"
+
 /**
  * @brief Main function to process chemical formulas from a file for testing.
  * 
  * This function reads chemical formulas from an input file, expands each formula, and writes the 
- * results to an output file.
+ * results to an output file. The formulas may have any length: the buffer for the expanded
+ * formula is sized with `extendedSize` before each expansion.
  * 
  * @param argc The argument count.
  * @param argv The argument vector, containing program name, input file, and output file.
  * @return int Returns 0 on successful execution, or -1 on error.
  */
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
+    if (argc < 3) {
         printf("Usage: %s <input_file> <output_file>\n", argv[0]);
         return -1;
     }
 
-    FILE *in, *out;
-    in = fopen(argv[1], "r"); // Open input file for reading
+    READER *in;
+    FILE *out;
+    in = openReader(argv[1]); // Open input file for reading
     if (in == NULL) {
         perror("Unable to open input file\n"); // Print error if file fails to open
         exit(-1); // Exit with error code
@@ -186,24 +380,48 @@ int main(int argc, char *argv[]) {
         exit(-1); // Exit with error code
     }
 
-    char chem[50]; // Buffer for each chemical formula read from input file
+    const char *chem; // Each chemical formula read from input file
+    size_t len;
+    char *ext = NULL; // Buffer for expanded formula, grown as needed
+    size_t extSize = 0;
     int flag, line = 1; // Track line number and function result
     bool AllGood = true; // Flag to check if all formulas are processed correctly
+    EXTSIZE size;
 
     // Process each formula in the input file
-    while (fscanf(in, "%s", chem) != EOF) {
-        char ext[50] = "";  // Buffer for expanded formula
-        flag = extenedChem(chem, ext);  // Expand formula
+    while (nextFormula(in, &chem, &len)) {
+        flag = (len > INT_MAX) ? CHEM_OVERFLOW : extendedSize(chem, (int)len, &size);
+        if (flag == EXIT_SUCCESS && size.buffer > INT_MAX) {
+            flag = CHEM_OVERFLOW;
+        }
+        if (flag == EXIT_SUCCESS && size.buffer > extSize) {
+            char *temp = (char *)realloc(ext, size.buffer);
+            if (temp == NULL) {
+                flag = CHEM_NO_MEMORY;
+            } else {
+                ext = temp;
+                extSize = size.buffer;
+            }
+        }
+        if (flag == EXIT_SUCCESS) {
+            flag = extenedChem(chem, (int)len, ext);  // Expand formula
+        }
 
         // Check for errors or write expanded formula to output
         if (flag == EXIT_FAILURE) {
             printf("Parentheses are NOT balanced in line: %d\n", line);
             AllGood = false; // Mark as unbalanced
-            fprintf(out, "Parentheses are NOT balanced: %s\n", chem);
+            fprintf(out, "Parentheses are NOT balanced: %.*s\n", (int)len, chem); // Only formulas shorter than INT_MAX are checked
+        } else if (flag != EXIT_SUCCESS) {
+            printf("Formula too large or out of memory in line: %d\n", line);
+            fputs("Formula too large: ", out);
+            fwrite(chem, 1, len, out);
+            fputc('\n', out);
         } else {
             fprintf(out, "%s\n", ext); // Write expanded formula to output
         }
 
+        releaseFormulas(in);
         line++; // Increment line number
     }
 
@@ -212,7 +430,8 @@ int main(int argc, char *argv[]) {
         printf("Parentheses are balanced for all chemical formulas.\n");
     }
 
-    fclose(in); // Close input file
+    free(ext);
+    closeReader(in); // Close input file
     fclose(out); // Close output file
     return 0; // Return success
 }
@@ -2,6 +2,18 @@
 #define CHEM_EXT
 
 
-int extenedChem(const char * const chem, char *extchem);
+#include <stddef.h>
+
+/**
+ * @brief Exact size of the extended version of a formula (see `extendedSize`).
+ */
+typedef struct {
+    size_t length;  ///< Length of the extended formula, without the null terminator
+    size_t buffer;  ///< Bytes `extenedChem` needs, with the null terminator (dropped groups are written first)
+    size_t atoms;   ///< Number of atoms (element symbols) in the extended formula
+} EXTSIZE;
+
+int extenedChem(const char * const chem, int length, char *extchem);
+int extendedSize(const char * const chem, int length, EXTSIZE *size);
 
 #endif // CHEM_EXT
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "chemIter.h"
+#include "chemCount.h"
+#include "stack.h"
+
+/**
+ * @brief Finds the matching ')' of every '(' of the formula, and the groups that yield no atoms.
+ *
+ * A group yields no atoms when its body only holds elements with a multiplier of 0
+ * and groups that yield none or have a multiplier of 0, like `(H0)` or `((C)0)`.
+ * Such a group is recorded as `-1 - close`, so the walks skip it with its multiplier
+ * instead of walking it once per repetition for nothing.
+ *
+ * @param chem The chemical formula.
+ * @param length The length of the formula.
+ * @param match Array of `length` integers; `match[i]` receives the position of the ')' that closes
+ *        the '(' at `i`, or `-1 -` that position if the group yields no atoms.
+ * @param most The largest group multiplier that is accepted.
+ * @return int Returns EXIT_SUCCESS, EXIT_FAILURE if the parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a group multiplier is over `most` (or does not fit in 64 bits),
+ *         or CHEM_NO_MEMORY.
+ */
+int matchParentheses(const char *chem, int length, int *match, long long most) {
+    int flag = EXIT_SUCCESS;
+    int open;
+    STACK stack;
+    setupStack(&stack);
+
+    for (int i = 0; i < length; i++) {
+        if (chem[i] == '(') {
+            if (pushINT(i, &stack) == EXIT_FAILURE) {
+                flag = CHEM_NO_MEMORY;
+                break;
+            }
+            match[i] = -1; // No atoms so far
+        } else if (chem[i] == ')') {
+            if (isEmpty(&stack)) {
+                flag = EXIT_FAILURE; // No matching '('
+                break;
+            }
+            popINT(&stack, &open);
+            int atoms = (match[open] != -1);
+            match[open] = atoms ? i : -1 - i;
+            long long count = readMultiplier(chem, length, &i);
+            if (count < 0 || count > most) {
+                flag = CHEM_OVERFLOW;
+            }
+            if (atoms && count > 0 && !isEmpty(&stack)) {
+                match[*top(&stack)] = 0; // The enclosing group yields atoms
+            }
+        } else if (chem[i] >= 'A' && chem[i] <= 'Z' && !isEmpty(&stack)) {
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+            }
+            if (readMultiplier(chem, length, &i) != 0) {
+                match[*top(&stack)] = 0; // The group yields atoms
+            }
+        }
+    }
+    if (flag == EXIT_SUCCESS && !isEmpty(&stack)) {
+        flag = EXIT_FAILURE;
+    }
+    clearStack(&stack);
+    return flag;
+}
+
+/**
+ * @brief Starts iterating over the atoms of a formula.
+ *
+ * The formula is checked first, in one pass that keeps no stack: the parentheses
+ * must be balanced and the multipliers must fit in 64 bits, so `nextAtom` cannot
+ * fail. Then the groups are matched once with `matchParentheses`, and the frames
+ * for the deepest group are allocated (only past `STACK_INLINE` nested groups).
+ * The iterator must not be copied.
+ *
+ * @param it The iterator.
+ * @param chem The chemical formula; it does not have to be null-terminated, and it
+ *        must stay valid until `closeAtoms`.
+ * @param length The length of the formula.
+ * @return int Returns EXIT_SUCCESS, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a multiplier does not fit in 64 bits, or CHEM_NO_MEMORY.
+ */
+int openAtoms(ATOMITER *it, const char * const chem, int length) {
+    int depth = 0, deepest = 0;
+    int overflow = 0;
+
+    it->frames = it->inl;
+    it->match = NULL;
+    for (int i = 0; i < length; i++) {
+        if (chem[i] == '(') {
+            depth++;
+            deepest = (depth > deepest) ? depth : deepest;
+        } else if (chem[i] == ')') {
+            if (depth == 0) {
+                return EXIT_FAILURE; // No matching '('
+            }
+            depth--;
+        } else if (chem[i] >= '0' && chem[i] <= '9') {
+            i--;
+            overflow |= (readMultiplier(chem, length, &i) < 0);
+        }
+    }
+    if (depth > 0) {
+        return EXIT_FAILURE; // Unmatched '('
+    }
+    if (overflow) {
+        return CHEM_OVERFLOW;
+    }
+
+    if (deepest > 0) {
+        it->match = (int *)malloc(length * sizeof(int));
+        if (it->match == NULL || matchParentheses(chem, length, it->match, LLONG_MAX) != EXIT_SUCCESS) {
+            free(it->match);
+            it->match = NULL;
+            return CHEM_NO_MEMORY; // The formula was checked, so only memory can fail
+        }
+    }
+    if (deepest > STACK_INLINE) {
+        it->frames = (ATOMFRAME *)malloc(deepest * sizeof(ATOMFRAME));
+        if (it->frames == NULL) {
+            it->frames = it->inl;
+            free(it->match);
+            it->match = NULL;
+            return CHEM_NO_MEMORY;
+        }
+    }
+    it->chem = chem;
+    it->length = length;
+    it->pos = 0;
+    it->sym = NULL;
+    it->len = 0;
+    it->left = 0;
+    it->depth = 0;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Produces the next atom of the extended version of the formula.
+ *
+ * Characters that are not part of an element, a group or a multiplier are
+ * skipped, like digits that do not follow an element or a group.
+ *
+ * @param it The iterator.
+ * @param sym Receives a pointer to the symbol of the atom (inside the formula).
+ * @param len Receives the length of the symbol.
+ * @return int 1 if an atom was produced, 0 once all the atoms have been produced.
+ */
+int nextAtom(ATOMITER *it, const char **sym, int *len) {
+    const char *chem = it->chem;
+    int length = it->length;
+
+    while (it->left == 0) {
+        if (it->pos >= length) {
+            return 0;
+        }
+        int i = it->pos;
+        char c = chem[i];
+
+        // An element: its atoms are produced one by one
+        if (c >= 'A' && c <= 'Z') {
+            int start = i;
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+            }
+            it->sym = &chem[start];
+            it->len = i - start + 1;
+            it->left = readMultiplier(chem, length, &i);
+        }
+        // Opening parenthesis: enter the group, which is walked once per repetition
+        else if (c == '(') {
+            int end = it->match[i];
+            long long count;
+            if (end < 0) {
+                i = -1 - end;
+                readMultiplier(chem, length, &i); // No atoms in any copy: skip the group
+            } else if ((count = readMultiplier(chem, length, &end)) == 0) {
+                i = end; // No copies: skip the group
+            } else {
+                it->frames[it->depth].start = i;
+                it->frames[it->depth].left = count - 1;
+                it->depth++;
+            }
+        }
+        // Closing parenthesis: walk the group again, or leave it
+        else if (c == ')') {
+            ATOMFRAME *f = &it->frames[it->depth - 1];
+            if (f->left > 0) {
+                f->left--;
+                i = f->start;
+            } else {
+                it->depth--;
+                readMultiplier(chem, length, &i); // Skip the multiplier
+            }
+        }
+        // Anything else (such as stray digits) is skipped
+        it->pos = i + 1;
+    }
+
+    it->left--;
+    *sym = it->sym;
+    *len = it->len;
+    return 1;
+}
+
+/**
+ * @brief Releases the frames and the group matches of an iterator.
+ */
+void closeAtoms(ATOMITER *it) {
+    if (it->frames != it->inl) {
+        free(it->frames);
+    }
+    free(it->match);
+    it->frames = it->inl;
+    it->match = NULL;
+}
+
+/**
+ * @brief Writes the extended version of a formula one atom at a time.
+ *
+ * The atoms come from an `ATOMITER` and go straight to the writer, which hands
+ * them to its sink whenever its buffer is full, so an extended version of any
+ * size is written in chunks without being built in memory. The atoms are
+ * separated by single spaces.
+ *
+ * Nothing is written if the parentheses are unbalanced or a multiplier is too large.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param out The writer that receives the atoms (without a newline).
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a multiplier does not fit in 64 bits, or CHEM_NO_MEMORY.
+ */
+int atomsChem(const char * const chem, int length, WRITER *out) {
+    ATOMITER it;
+    const char *sym;
+    int len;
+
+    int flag = openAtoms(&it, chem, length);
+    if (flag != EXIT_SUCCESS) {
+        return flag;
+    }
+    if (nextAtom(&it, &sym, &len)) {
+        writeBytes(out, sym, len);
+        while (nextAtom(&it, &sym, &len)) {
+            writeChar(out, ' ');
+            writeBytes(out, sym, len);
+        }
+    }
+    closeAtoms(&it);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+#ifndef CHEM_ITER
+#define CHEM_ITER
+
+#include "writer.h"
+#include "stack.h"
+
+/**
+ * @brief A group that is being walked by an `ATOMITER`.
+ */
+typedef struct {
+    int start;              ///< Position of the '(' of the group
+    long long left;         ///< Repetitions of the group still to walk after this one
+} ATOMFRAME;
+
+/**
+ * @brief Iterator over the atoms of the extended version of a formula, in order.
+ *
+ * The atoms are produced on demand from the formula itself, without building the
+ * extended version: a group is walked again for every repetition, using a stack of
+ * (start of the group, repetitions left) frames. The memory used is proportional to
+ * the length and the nesting depth of the formula, however long its extended version is.
+ */
+typedef struct {
+    const char *chem;       ///< The formula
+    int length;             ///< The length of the formula
+    int pos;                ///< Where the walk continues
+    const char *sym;        ///< The symbol of the current element
+    int len;                ///< Length of `sym`
+    long long left;         ///< Atoms of the current element still to produce
+    int *match;             ///< The ')' of every '(' (see `matchParentheses`), or NULL without groups
+    ATOMFRAME *frames;      ///< The groups being walked, innermost last
+    int depth;              ///< Number of groups being walked
+    ATOMFRAME inl[STACK_INLINE]; ///< Inline storage for the frames of shallow formulas
+} ATOMITER;
+
+
+int matchParentheses(const char *chem, int length, int *match, long long most);
+int openAtoms(ATOMITER *it, const char * const chem, int length);
+int nextAtom(ATOMITER *it, const char **sym, int *len);
+void closeAtoms(ATOMITER *it);
+int atomsChem(const char * const chem, int length, WRITER *out);
+
+#endif // CHEM_ITER
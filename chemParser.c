@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "chemParser.h"
+#include "chemCount.h"
+#include "chemExt.h"
+#include "parenthesisBal.h"
+#include "protonNum.h"
+#include "groupMemo.h"
+
+/**
+ * @brief State of a parser that is kept from one formula to the next.
+ */
+struct PARSER {
+    const PTABLE *pert;     ///< The periodic table (the built-in one, or one loaded from a file)
+    GROUPMEMO *memo;        ///< Compositions of the group bodies seen so far (NULL if disabled)
+    char *ext;              ///< Buffer for the extended formula
+    size_t extSize;         ///< Size of `ext`
+    void *scratch;          ///< Buffer for the element tokens of `countChem`
+    size_t scratchSize;     ///< Size of `scratch`
+    char *arena;            ///< The extended formulas of the last batch
+    size_t arenaSize;       ///< Size of `arena`
+    long long counts[N];    ///< The element counts of the last formula counted
+};
+
+/**
+ * @brief Checks the (pointer, length) view of a formula.
+ */
+static int badFormula(const PARSER *parser, const char *chem, int length) {
+    return parser == NULL || length < 0 || (chem == NULL && length > 0);
+}
+
+/**
+ * @brief Creates a parser.
+ *
+ * @param parser Receives the parser; release it with `freeParser`.
+ * @param table The periodic table file, or NULL for the built-in table.
+ * @param memoSize Number of group bodies whose composition is remembered (0 disables the memo, at most MEMO_MAX).
+ * @param err NULL, or a buffer of `CHEM_ERROR_SIZE` bytes that receives the reason a table
+ *        file was rejected.
+ * @return int CHEM_OK, CHEM_NO_TABLE, CHEM_BAD_TABLE, CHEM_NO_MEMORY or CHEM_BAD_ARGUMENT.
+ */
+int createParser(PARSER **parser, const char *table, int memoSize, char *err) {
+    if (parser == NULL || memoSize < 0 || memoSize > MEMO_MAX) {
+        return CHEM_BAD_ARGUMENT;
+    }
+    *parser = NULL;
+
+    PARSER *p = (PARSER *)calloc(1, sizeof(PARSER));
+    if (p == NULL) {
+        return CHEM_NO_MEMORY;
+    }
+    int status = createTable(table, &p->pert, err);
+    if (status != CHEM_OK) {
+        free(p);
+        return status;
+    }
+    if (memoSize > 0) {
+        p->memo = createMemo(memoSize);
+        if (p->memo == NULL) {
+            freeParser(p);
+            return CHEM_NO_MEMORY;
+        }
+    }
+    *parser = p;
+    return CHEM_OK;
+}
+
+/**
+ * @brief Releases a parser, with its table and buffers.
+ *
+ * @param parser The parser, or NULL.
+ */
+void freeParser(PARSER *parser) {
+    if (parser == NULL) {
+        return;
+    }
+    if (parser->pert != NULL) {
+        freeTable(parser->pert);
+    }
+    freeMemo(parser->memo);
+    free(parser->ext);
+    free(parser->scratch);
+    free(parser->arena);
+    free(parser);
+}
+
+/**
+ * @brief Gets the periodic table of a parser, to map the slots of `countFormula` to symbols.
+ */
+const PTABLE *parserTable(const PARSER *parser) {
+    return parser->pert;
+}
+
+/**
+ * @brief Checks if the parentheses of a formula are balanced.
+ *
+ * @return int CHEM_OK, CHEM_UNBALANCED or CHEM_BAD_ARGUMENT.
+ */
+int validateFormula(PARSER *parser, const char *chem, int length) {
+    if (badFormula(parser, chem, length)) {
+        return CHEM_BAD_ARGUMENT;
+    }
+    return parB(chem, length);
+}
+
+/**
+ * @brief Computes the extended version of a formula.
+ *
+ * @param ext Receives the extended formula (null-terminated). It is kept in the parser
+ *        and stays valid until the next call of `expandFormula` or `freeParser`.
+ * @param extLength Receives the length of the extended formula, or NULL.
+ * @return int CHEM_OK, CHEM_UNBALANCED, CHEM_OVERFLOW if the extended formula does not fit
+ *         in memory (or is longer than INT_MAX), CHEM_NO_MEMORY or CHEM_BAD_ARGUMENT.
+ */
+int expandFormula(PARSER *parser, const char *chem, int length, const char **ext, size_t *extLength) {
+    if (badFormula(parser, chem, length) || ext == NULL) {
+        return CHEM_BAD_ARGUMENT;
+    }
+
+    // Size the buffer exactly for the expanded formula
+    EXTSIZE size;
+    int status = extendedSize(chem, length, &size);
+    if (status != CHEM_OK) {
+        return status;
+    }
+    if (size.buffer > INT_MAX) {
+        return CHEM_OVERFLOW;
+    }
+    if (size.buffer > parser->extSize) {
+        char *temp = (char *)realloc(parser->ext, size.buffer);
+        if (temp == NULL) {
+            return CHEM_NO_MEMORY;
+        }
+        parser->ext = temp;
+        parser->extSize = size.buffer;
+    }
+
+    parser->ext[0] = '\0';
+    status = extenedChem(chem, length, parser->ext);
+    if (status != CHEM_OK) {
+        return status;
+    }
+    *ext = parser->ext;
+    if (extLength != NULL) {
+        *extLength = size.length;
+    }
+    return CHEM_OK;
+}
+
+/**
+ * @brief Computes the number of atoms of each element of a formula.
+ *
+ * @param counts Receives the counts, indexed by the slots of the table (see `parserTable`).
+ *        They are kept in the parser and stay valid until the next call of `countFormula`.
+ * @return int CHEM_OK, CHEM_UNBALANCED, CHEM_OVERFLOW if a count does not fit in 64 bits,
+ *         CHEM_UNKNOWN if an element is not in the table (the counts of the others are
+ *         filled), CHEM_NO_MEMORY or CHEM_BAD_ARGUMENT.
+ */
+int countFormula(PARSER *parser, const char *chem, int length, const long long **counts) {
+    if (badFormula(parser, chem, length) || counts == NULL) {
+        return CHEM_BAD_ARGUMENT;
+    }
+    int status = countChem(chem, length, parser->counts, parser->pert, parser->memo, NULL,
+                           &parser->scratch, &parser->scratchSize);
+    *counts = parser->counts;
+    return status;
+}
+
+/**
+ * @brief Computes the total proton number (atomic number) of a formula.
+ *
+ * @param atnum Receives the total.
+ * @return int CHEM_OK, CHEM_UNBALANCED, CHEM_OVERFLOW if the total does not fit in 64 bits,
+ *         CHEM_UNKNOWN if an element is not in the table, CHEM_NO_MEMORY or CHEM_BAD_ARGUMENT.
+ */
+int protonFormula(PARSER *parser, const char *chem, int length, long long *atnum) {
+    if (badFormula(parser, chem, length) || atnum == NULL) {
+        return CHEM_BAD_ARGUMENT;
+    }
+    return protonChem(chem, length, atnum, parser->pert, parser->memo, NULL);
+}
+
+/**
+ * @brief Makes room for `size` more bytes after the first `used` bytes of the arena.
+ *
+ * @return int CHEM_OK, CHEM_OVERFLOW if the arena would not fit in memory, or CHEM_NO_MEMORY.
+ */
+static int reserveArena(PARSER *parser, size_t used, size_t size) {
+    if (size > SIZE_MAX - used) {
+        return CHEM_OVERFLOW;
+    }
+    if (used + size <= parser->arenaSize) {
+        return CHEM_OK;
+    }
+    size_t capacity = (parser->arenaSize == 0) ? 4096 : parser->arenaSize;
+    while (capacity < used + size) {
+        capacity = (capacity > SIZE_MAX / 2) ? used + size : 2 * capacity;
+    }
+    char *temp = (char *)realloc(parser->arena, capacity);
+    if (temp == NULL) {
+        return CHEM_NO_MEMORY;
+    }
+    parser->arena = temp;
+    parser->arenaSize = capacity;
+    return CHEM_OK;
+}
+
+/**
+ * @brief Adds up the atomic numbers over an element count vector, checking for overflow.
+ */
+static int countsTotal(const long long *counts, const PTABLE *pert, long long *atnum) {
+    long long total = 0, atoms;
+    for (int i = 0; i < N; i++) {
+        if (__builtin_mul_overflow(counts[i], (long long)pert->anum[i], &atoms) ||
+            __builtin_add_overflow(total, atoms, &total))
+            return CHEM_OVERFLOW;
+    }
+    *atnum = total;
+    return CHEM_OK;
+}
+
+/**
+ * @brief Processes an array of formulas in one call, filling parallel result arrays.
+ *
+ * Every formula gets a status code, and the results that were asked for: its proton
+ * total, its element counts and its extended version. The extended versions are
+ * written by `extenedChem` one after the other into an arena that the parser keeps
+ * and reuses, and are located by their offsets (the arena may move while it grows,
+ * so no pointers are handed out). When both the counts and the total are asked
+ * for, the total is computed from the counts, so every formula is parsed once for
+ * them; the total alone comes from the single-pass `protonChem`.
+ *
+ * A formula that fails has the status of the first result that failed; its total
+ * is 0, its extended version is empty and its counts are 0 (except for CHEM_UNKNOWN,
+ * where the counts of the known elements are filled, as with `countFormula`).
+ *
+ * @param parser The parser.
+ * @param chem The formulas (views that do not have to be null-terminated).
+ * @param length The length of every formula.
+ * @param count The number of formulas.
+ * @param results The result arrays; `status` is required.
+ * @return int CHEM_OK if every formula was processed (whatever its own status),
+ *         CHEM_NO_MEMORY if the arena could not grow (the formulas from there on are
+ *         marked CHEM_NO_MEMORY, or CHEM_OVERFLOW if the arena would not fit in memory),
+ *         or CHEM_BAD_ARGUMENT.
+ */
+int parseFormulas(PARSER *parser, const char * const *chem, const int *length, int count, RESULTS *results) {
+    if (parser == NULL || results == NULL || results->status == NULL || count < 0 ||
+        (count > 0 && (chem == NULL || length == NULL))) {
+        return CHEM_BAD_ARGUMENT;
+    }
+
+    size_t used = 0;
+    int flag = CHEM_OK;
+    for (int i = 0; i < count; i++) {
+        int status = badFormula(parser, chem[i], length[i]) ? CHEM_BAD_ARGUMENT : CHEM_OK;
+        long long atnum = 0;
+
+        // The extended version goes straight into the arena
+        if (results->extOffset != NULL || results->extLength != NULL) {
+            EXTSIZE size = { .buffer = 1 };
+            size_t start = used;
+            if (status == CHEM_OK) {
+                status = extendedSize(chem[i], length[i], &size);
+                if (status == CHEM_OK && size.buffer > INT_MAX) {
+                    status = CHEM_OVERFLOW;
+                }
+                if (status != CHEM_OK) {
+                    size.buffer = 1;
+                }
+            }
+            int reserved = reserveArena(parser, used, size.buffer);
+            if (reserved != CHEM_OK) {
+                // Give up on this formula and the ones after it
+                for (; i < count; i++) {
+                    results->status[i] = reserved;
+                }
+                flag = CHEM_NO_MEMORY;
+                break;
+            }
+            parser->arena[used] = '\0';
+            size_t extLength = 0;
+            if (status == CHEM_OK) {
+                status = extenedChem(chem[i], length[i], parser->arena + used);
+                if (status == CHEM_OK) {
+                    extLength = size.length;
+                } else {
+                    parser->arena[used] = '\0';
+                }
+            }
+            used += extLength + 1;
+            if (results->extOffset != NULL) results->extOffset[i] = start;
+            if (results->extLength != NULL) results->extLength[i] = used - start - 1;
+        }
+
+        // The counts, and the total from them or from a single pass
+        if (results->counts != NULL) {
+            long long *counts = results->counts + (size_t)i * N;
+            if (status == CHEM_OK) {
+                status = countChem(chem[i], length[i], counts, parser->pert, parser->memo, NULL,
+                                   &parser->scratch, &parser->scratchSize);
+            }
+            if (status == CHEM_OK && results->atnum != NULL) {
+                status = countsTotal(counts, parser->pert, &atnum);
+            }
+            if (status != CHEM_OK && status != CHEM_UNKNOWN) {
+                memset(counts, 0, N * sizeof(long long));
+            }
+        } else if (results->atnum != NULL && status == CHEM_OK) {
+            status = protonChem(chem[i], length[i], &atnum, parser->pert, parser->memo, NULL);
+        }
+
+        if (results->atnum != NULL) {
+            results->atnum[i] = (status == CHEM_OK) ? atnum : 0;
+        }
+        results->status[i] = status;
+    }
+
+    results->arena = parser->arena;
+    results->arenaLength = used;
+    return flag;
+}
+
+/**
+ * @brief Describes a status code.
+ *
+ * @return const char* A short description (a static string).
+ */
+const char *statusMessage(int status) {
+    switch (status) {
+    case CHEM_OK: return "success";
+    case CHEM_UNBALANCED: return "parentheses are not balanced";
+    case CHEM_OVERFLOW: return "formula too large";
+    case CHEM_NO_MEMORY: return "out of memory";
+    case CHEM_UNKNOWN: return "element not found in periodic table";
+    case CHEM_NO_TABLE: return "unable to open the periodic table";
+    case CHEM_BAD_TABLE: return "invalid periodic table";
+    case CHEM_BAD_ARGUMENT: return "invalid argument";
+    }
+    return "unknown status";
+}
+
+#ifdef DEBUG5
+static int failures = 0;
+
+/**
+ * @brief Prints a check of the DEBUG5 harness and counts it if it failed.
+ */
+static void check(const char *what, int passed) {
+    printf("%s: %s\n", passed ? "ok  " : "FAIL", what);
+    if (!passed) {
+        failures++;
+    }
+}
+
+/**
+ * @brief Main function for testing the parser library in debug mode.
+ *
+ * This function is compiled only when DEBUG5 is defined. It creates a parser and
+ * checks the status codes and results of `expandFormula`, `countFormula`,
+ * `protonFormula` and `parseFormulas`, including a batch whose extended formulas
+ * outgrow the arena halfway through (the offsets must still locate every formula).
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector; `argv[1]` is an optional periodic table file (the built-in table otherwise).
+ * @return Returns 0 if every check passed, -1 otherwise.
+ */
+int main(int argc, char *argv[]) {
+    PARSER *p;
+    char err[CHEM_ERROR_SIZE];
+
+    check("createParser rejects a NULL parser", createParser(NULL, NULL, 0, err) == CHEM_BAD_ARGUMENT);
+    check("createParser rejects a negative memo size", createParser(&p, NULL, -1, err) == CHEM_BAD_ARGUMENT);
+    check("createParser rejects a memo size over MEMO_MAX",
+          createParser(&p, NULL, MEMO_MAX + 1, err) == CHEM_BAD_ARGUMENT);
+    check("createParser reports a missing table",
+          createParser(&p, "/nonexistent/table", 0, err) == CHEM_NO_TABLE && p == NULL);
+
+    int status = createParser(&p, (argc > 1) ? argv[1] : NULL, 64, err);
+    if (status != CHEM_OK) {
+        printf("Unable to create the parser: %s\n", (status == CHEM_BAD_TABLE) ? err : statusMessage(status));
+        return -1;
+    }
+    const PTABLE *pert = parserTable(p);
+    int h = findElement(pert, "H", 1), c = findElement(pert, "C", 1), o = findElement(pert, "O", 1);
+    if (h < 0 || c < 0 || o < 0 || findElement(pert, "Xx", 2) >= 0) {
+        printf("The periodic table must have H, C and O, and not Xx\n");
+        freeParser(p);
+        return -1;
+    }
+
+    // Single formulas
+    const char *ext;
+    size_t extLength;
+    const long long *counts;
+    long long atnum;
+    check("validateFormula accepts (CH2)2", validateFormula(p, "(CH2)2", 6) == CHEM_OK);
+    check("validateFormula rejects (H", validateFormula(p, "(H", 2) == CHEM_UNBALANCED);
+    check("validateFormula rejects a negative length", validateFormula(p, "H", -1) == CHEM_BAD_ARGUMENT);
+    check("expandFormula expands H2O",
+          expandFormula(p, "H2O", 3, &ext, &extLength) == CHEM_OK && extLength == 5 && strcmp(ext, "H H O") == 0);
+    check("expandFormula reads only the view", expandFormula(p, "H2O", 2, &ext, &extLength) == CHEM_OK &&
+          strcmp(ext, "H H ") == 0);
+    check("expandFormula rejects (H", expandFormula(p, "(H", 2, &ext, &extLength) == CHEM_UNBALANCED);
+    check("expandFormula rejects a count that overflows",
+          expandFormula(p, "(H)99999999999999999999", 23, &ext, &extLength) == CHEM_OVERFLOW);
+    check("expandFormula rejects an expansion over INT_MAX bytes",
+          expandFormula(p, "(H)3000000000", 13, &ext, &extLength) == CHEM_OVERFLOW);
+    check("expandFormula rejects a NULL formula", expandFormula(p, NULL, 1, &ext, &extLength) == CHEM_BAD_ARGUMENT);
+    check("countFormula counts CH3COOH", countFormula(p, "CH3COOH", 7, &counts) == CHEM_OK &&
+          counts[c] == 2 && counts[h] == 4 && counts[o] == 2);
+    check("countFormula fills the known elements of H2Xx3O",
+          countFormula(p, "H2Xx3O", 6, &counts) == CHEM_UNKNOWN && counts[h] == 2 && counts[o] == 1);
+    check("countFormula ignores an unknown element with a count of 0",
+          countFormula(p, "Xx0H2", 5, &counts) == CHEM_OK && counts[h] == 2);
+    check("protonFormula adds up H2O", protonFormula(p, "H2O", 3, &atnum) == CHEM_OK && atnum == 10);
+    check("protonFormula rejects Xx", protonFormula(p, "Xx", 2, &atnum) == CHEM_UNKNOWN);
+    check("protonFormula rejects a total that overflows",
+          protonFormula(p, "(O)9000000000000000000", 22, &atnum) == CHEM_OVERFLOW);
+
+    // A batch whose extended formulas outgrow the 4096-byte arena in the middle
+    enum { BATCH = 8 };
+    const char *chem[BATCH] = { "H2O", "(CH2)1000", "(H", "H2Xx3O", "", "CH3COOH", "(CH2)2000", "NaCl" };
+    int length[BATCH], status_[BATCH];
+    long long atnum_[BATCH], counts_[BATCH * N];
+    size_t offset[BATCH], length_[BATCH];
+    const int expected[BATCH] = { CHEM_OK, CHEM_OK, CHEM_UNBALANCED, CHEM_UNKNOWN, CHEM_OK, CHEM_OK, CHEM_OK, CHEM_OK };
+    for (int i = 0; i < BATCH; i++) {
+        length[i] = (int)strlen(chem[i]);
+    }
+    RESULTS results = { status_, atnum_, counts_, offset, length_, NULL, 0 };
+    for (int round = 0; round < 2; round++) {
+        printf("parseFormulas, %s arena\n", (round == 0) ? "a new" : "a reused");
+        check("parseFormulas processes the batch", parseFormulas(p, chem, length, BATCH, &results) == CHEM_OK);
+        size_t used = 0;
+        for (int i = 0; i < BATCH; i++) {
+            char what[64];
+            snprintf(what, sizeof(what), "formula %d (%.16s) has status %d", i, chem[i], expected[i]);
+            check(what, status_[i] == expected[i]);
+            snprintf(what, sizeof(what), "formula %d has its extended version at its offset", i);
+            int same = offset[i] == used && results.arena[offset[i] + length_[i]] == '\0';
+            if (expected[i] != CHEM_UNBALANCED) {
+                // The extended version does not depend on the table, so H2Xx3O has one
+                same = same && expandFormula(p, chem[i], length[i], &ext, &extLength) == CHEM_OK &&
+                       extLength == length_[i] && memcmp(ext, results.arena + offset[i], extLength) == 0;
+            } else {
+                same = same && length_[i] == 0;
+            }
+            check(what, same);
+            used = offset[i] + length_[i] + 1;
+            snprintf(what, sizeof(what), "formula %d has the counts and total of countFormula", i);
+            int counted = countFormula(p, chem[i], length[i], &counts);
+            same = (counted == expected[i]);
+            for (int k = 0; k < N; k++) {
+                same = same && counts_[i * N + k] == ((counted == CHEM_OK || counted == CHEM_UNKNOWN) ? counts[k] : 0);
+            }
+            long long total = 0;
+            same = same && (protonFormula(p, chem[i], length[i], &total) != CHEM_OK || atnum_[i] == total) &&
+                   (expected[i] == CHEM_OK || atnum_[i] == 0);
+            check(what, same);
+        }
+        check("parseFormulas reports the bytes used", results.arenaLength == used && used > 4096);
+    }
+    check("parseFormulas rejects a NULL status array",
+          parseFormulas(p, chem, length, BATCH, &(RESULTS){ .status = NULL }) == CHEM_BAD_ARGUMENT);
+    check("statusMessage describes every status", strcmp(statusMessage(CHEM_OK), "success") == 0 &&
+          strcmp(statusMessage(CHEM_BAD_ARGUMENT + 1), "unknown status") == 0);
+
+    freeParser(p);
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return -1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,49 @@
+#ifndef CHEM_PARSER
+#define CHEM_PARSER
+
+/*
+ * Public interface of the formula parser, for programs that link it in.
+ *
+ * A PARSER owns the periodic table and the buffers the functions reuse from one
+ * formula to the next, so processing a formula does not allocate once the buffers
+ * have grown to the size of the formulas. Formulas are passed as (pointer, length)
+ * views and do not have to be null-terminated. Every function returns one of the
+ * CHEM_* status codes and none of them ends the program or prints anything.
+ *
+ * A parser must not be used by two threads at the same time; use one per thread.
+ */
+
+#include <stddef.h>
+#include "chemStatus.h"
+#include "periodicTable.h"
+
+typedef struct PARSER PARSER;
+
+/**
+ * @brief Results of `parseFormulas`, as parallel arrays with one entry per formula.
+ *
+ * The caller provides the arrays; the ones that are NULL are not computed.
+ */
+typedef struct {
+    int *status;            ///< Status code of every formula (CHEM_OK, CHEM_UNBALANCED, ...)
+    long long *atnum;       ///< Total proton number of every formula, or NULL
+    long long *counts;      ///< `N` element counts per formula (formula `i` at `counts + i * N`), or NULL
+    size_t *extOffset;      ///< Offset of the extended formula of every formula in `arena`, or NULL
+    size_t *extLength;      ///< Length of the extended formula of every formula, or NULL
+    const char *arena;      ///< Set to the extended formulas (null-terminated, one after the other)
+    size_t arenaLength;     ///< Set to the number of bytes used in `arena`
+} RESULTS;
+
+int createParser(PARSER **parser, const char *table, int memoSize, char *err);
+void freeParser(PARSER *parser);
+const PTABLE *parserTable(const PARSER *parser);
+
+int validateFormula(PARSER *parser, const char *chem, int length);
+int expandFormula(PARSER *parser, const char *chem, int length, const char **ext, size_t *extLength);
+int countFormula(PARSER *parser, const char *chem, int length, const long long **counts);
+int protonFormula(PARSER *parser, const char *chem, int length, long long *atnum);
+int parseFormulas(PARSER *parser, const char * const *chem, const int *length, int count, RESULTS *results);
+
+const char *statusMessage(int status);
+
+#endif // CHEM_PARSER
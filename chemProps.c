@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "chemProps.h"
+#include "chemCount.h"
+
+/**
+ * @brief Names of the properties, as they are given on the command line.
+ */
+static const char * const propertyNames[PROPS] = {
+    [PROP_MASS] = "mass",
+    [PROP_ANUM] = "anum",
+    [PROP_ELECTRONS] = "electrons",
+    [PROP_VALENCE] = "valence",
+};
+
+/**
+ * @brief Decimals written for every property (the others are whole numbers).
+ */
+static const int propertyDecimals[PROPS] = {
+    [PROP_MASS] = 3,
+};
+
+/**
+ * @brief Parses a comma-separated list of property names, such as `mass,anum`.
+ *
+ * @param names The list.
+ * @param props Receives the properties, in the order of the list.
+ * @return int Returns EXIT_SUCCESS, or EXIT_FAILURE if a name is unknown, repeated or missing.
+ */
+int parseProperties(const char *names, PROPLIST *props) {
+    props->count = 0;
+    while (1) {
+        size_t len = strcspn(names, ",");
+        int p;
+        for (p = 0; p < PROPS; p++) {
+            if (strlen(propertyNames[p]) == len && strncmp(names, propertyNames[p], len) == 0)
+                break;
+        }
+        if (p == PROPS)
+            return EXIT_FAILURE; // Unknown or empty name
+        for (int k = 0; k < props->count; k++) {
+            if (props->list[k] == (PROPERTY)p)
+                return EXIT_FAILURE; // Repeated
+        }
+        props->list[props->count++] = p;
+        if (names[len] == '\0')
+            return EXIT_SUCCESS;
+        names += len + 1;
+    }
+}
+
+/**
+ * @brief Adds up the requested properties over an element count vector.
+ *
+ * Every property is the dot product of the counts with its column of the table.
+ * The counts are converted to doubles once and every requested column is reduced
+ * against them, four elements at a time in two SSE2 accumulators (one element at
+ * a time where SSE2 is not available). Whole-number properties are exact up to 2^53.
+ *
+ * @param counts The number of atoms of each element.
+ * @param pert Pointer to the periodic table.
+ * @param props The properties to add up.
+ * @param values Receives the sum of every property, in the order of `props`.
+ */
+void sumProperties(const long long counts[N], const PTABLE * const pert, const PROPLIST *props, double *values) {
+    double x[N] __attribute__((aligned(16)));
+
+    for (int k = 0; k < N; k++) {
+        x[k] = (double)counts[k];
+    }
+
+    for (int p = 0; p < props->count; p++) {
+        const double *column = pert->prop[props->list[p]];
+        double sum = 0;
+        int i = 0;
+#ifdef __SSE2__
+        __m128d acc0 = _mm_setzero_pd();
+        __m128d acc1 = _mm_setzero_pd();
+        for (; i + 4 <= N; i += 4) {
+            acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_load_pd(&x[i]), _mm_load_pd(&column[i])));
+            acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_load_pd(&x[i + 2]), _mm_load_pd(&column[i + 2])));
+        }
+        for (; i + 2 <= N; i += 2) {
+            acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_load_pd(&x[i]), _mm_load_pd(&column[i])));
+        }
+        acc0 = _mm_add_pd(acc0, acc1);
+        sum = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+#endif
+        // The elements that are left (all of them without SSE2)
+        for (; i < N; i++) {
+            sum += x[i] * column[i];
+        }
+        values[p] = sum;
+    }
+}
+
+/**
+ * @brief Computes several properties of a formula (mass, atomic number, ...) in one parse.
+ *
+ * The formula is evaluated into its element count vector with `countChem`, and
+ * the vector is reduced against every requested property column.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param props The properties to compute.
+ * @param values Receives the value of every property, in the order of `props`.
+ * @param pert Pointer to a constant `PTABLE` structure containing periodic table data.
+ * @param memo The compositions of the groups seen so far, or NULL.
+ * @param out The writer that receives the error messages for unknown elements, or NULL.
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a count does not fit in 64 bits, CHEM_NO_MEMORY, or CHEM_UNKNOWN
+ *         (without a writer) if an element is not in the table.
+ */
+int propsChem(const char * const chem, int length, const PROPLIST *props, double *values, const PTABLE * const pert, GROUPMEMO *memo, WRITER *out) {
+    long long counts[N];
+
+    int flag = countChem(chem, length, counts, pert, memo, out, NULL, NULL);
+    if (flag != EXIT_SUCCESS)
+        return flag;
+
+    sumProperties(counts, pert, props, values);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes the values of the properties, separated by spaces (without a newline).
+ */
+void writeProperties(WRITER *w, const PROPLIST *props, const double *values) {
+    for (int p = 0; p < props->count; p++) {
+        if (p > 0) {
+            writeChar(w, ' ');
+        }
+        writeFixed(w, values[p], propertyDecimals[props->list[p]]);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef CHEM_PROPS
+#define CHEM_PROPS
+
+#include "periodicTable.h" // Include the periodic table definition
+#include "writer.h"
+#include "groupMemo.h"
+
+/**
+ * @brief The properties that are computed for every formula, in output order.
+ */
+typedef struct {
+    int count;              ///< Number of properties
+    PROPERTY list[PROPS];   ///< The properties
+} PROPLIST;
+
+
+int parseProperties(const char *names, PROPLIST *props);
+void sumProperties(const long long counts[N], const PTABLE * const pert, const PROPLIST *props, double *values);
+int propsChem(const char * const chem, int length, const PROPLIST *props, double *values, const PTABLE * const pert, GROUPMEMO *memo, WRITER *out);
+void writeProperties(WRITER *w, const PROPLIST *props, const double *values);
+
+#endif // CHEM_PROPS
@@ -0,0 +1,20 @@
+#ifndef CHEM_STATUS
+#define CHEM_STATUS
+
+/*
+ * Status codes of the parser functions. The first two are EXIT_SUCCESS and
+ * EXIT_FAILURE, which the functions have always returned; none of the functions
+ * ends the program.
+ */
+#define CHEM_OK 0           ///< Success (EXIT_SUCCESS)
+#define CHEM_UNBALANCED 1   ///< The parentheses are not balanced (EXIT_FAILURE)
+#define CHEM_OVERFLOW 2     ///< A multiplier or a total does not fit in 64 bits, or the result does not fit in memory
+#define CHEM_NO_MEMORY 3    ///< Memory could not be allocated
+#define CHEM_UNKNOWN 4      ///< An element is not in the periodic table (when there is no writer for the messages)
+#define CHEM_NO_TABLE 5     ///< The periodic table file could not be opened or read
+#define CHEM_BAD_TABLE 6    ///< The periodic table file is not valid
+#define CHEM_BAD_ARGUMENT 7 ///< An argument is not valid (such as a negative length)
+
+#define CHEM_ERROR_SIZE 128 ///< Size of the buffers that receive the details of an error
+
+#endif // CHEM_STATUS
@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "elementIndex.h"
+
+_Static_assert(N <= INDEX_FAILED, "the slots and the failed bit must fit in 128 bits");
+_Static_assert(sizeof(INDEXHEADER) % 8 == 0, "the records must be aligned");
+
+/**
+ * @brief Atomic numbers of the elements that are not metals (nonmetals, noble gases and metalloids).
+ */
+static const int nonMetals[] = { 1, 2, 5, 6, 7, 8, 9, 10, 14, 15, 16, 17, 18, 32, 33, 34, 35, 36, 51, 52, 53, 54, 85, 86, 117, 118 };
+
+/**
+ * @brief Sets the bit of a slot.
+ */
+static void setBit(ELEMENTBITS *b, int slot) {
+    b->w[slot >> 6] |= 1ULL << (slot & 63);
+}
+
+/**
+ * @brief Writes the header of an index built with the periodic table `pert`.
+ */
+void writeIndexHeader(WRITER *out, const PTABLE * const pert) {
+    INDEXHEADER h;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+    h.elements = N;
+    h.version = 1;
+    memcpy(h.ch, pert->ch, sizeof(h.ch));
+    for (int k = 0; k < N; k++) {
+        h.anum[k] = pert->anum[k];
+    }
+    writeBytes(out, (const char *)&h, sizeof(h));
+}
+
+/**
+ * @brief Writes the record of a formula: the elements present, then their atoms.
+ *
+ * @param out The writer of the index file.
+ * @param counts The number of atoms of each element of the formula (from `countChem`).
+ */
+void writeIndexRecord(WRITER *out, const long long counts[N]) {
+    ELEMENTBITS b = { { 0, 0 } };
+    int64_t atoms[N];
+    int k = 0;
+
+    for (int slot = 0; slot < N; slot++) {
+        if (counts[slot] != 0) {
+            setBit(&b, slot);
+            atoms[k++] = counts[slot];
+        }
+    }
+    writeBytes(out, (const char *)&b, sizeof(b));
+    writeBytes(out, (const char *)atoms, k * sizeof(int64_t));
+}
+
+/**
+ * @brief Writes the record of a formula that could not be counted.
+ */
+void writeIndexFailed(WRITER *out) {
+    ELEMENTBITS b = { { 0, 0 } };
+
+    setBit(&b, INDEX_FAILED);
+    writeBytes(out, (const char *)&b, sizeof(b));
+}
+
+/**
+ * @brief Finds the slot of a symbol in the table of an index.
+ *
+ * @return int The slot, or -1 if the symbol is not in the table.
+ */
+static int findSymbol(const INDEXHEADER *h, const char *sym, int len) {
+    if (len == 0 || len > 2) {
+        return -1;
+    }
+    for (int k = 0; k < N; k++) {
+        if (strncmp(h->ch[k], sym, len) == 0 && h->ch[k][len] == '\0') {
+            return k;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the elements of the table of an index that are metals.
+ */
+static ELEMENTBITS metals(const INDEXHEADER *h) {
+    ELEMENTBITS b = { { 0, 0 } };
+
+    for (int k = 0; k < N; k++) {
+        int metal = (h->ch[k][0] != '\0');
+        for (size_t m = 0; m < sizeof(nonMetals) / sizeof(nonMetals[0]) && metal; m++) {
+            metal = (h->anum[k] != nonMetals[m]);
+        }
+        if (metal) {
+            setBit(&b, k);
+        }
+    }
+    return b;
+}
+
+/**
+ * @brief Compiles a query into masks and count conditions.
+ *
+ * A query is a list of terms separated by commas or spaces, which must all hold:
+ * - `X`: the formula contains element X; `!X`: it does not.
+ * - `X>=3` (also `>`, `<=`, `<`, `=`, `!=`): a condition on the atoms of X.
+ * - `metal`: the formula contains a metal; `!metal`: it contains none.
+ * - `X|Y|Z`: the formula contains at least one of them (one such term per query,
+ *   counting `metal`).
+ *
+ * The presence terms, and the count conditions that imply one (such as `O>=3`),
+ * become bits of the masks; the other count conditions are kept as terms.
+ *
+ * @param text The query.
+ * @param h The header of the index, for the symbols.
+ * @param q Receives the compiled query.
+ * @param err Receives the reason if the query is invalid (`CHEM_ERROR_SIZE` bytes).
+ * @return int Returns EXIT_SUCCESS, or CHEM_BAD_ARGUMENT if the query is invalid.
+ */
+int parseQuery(const char *text, const INDEXHEADER *h, QUERY *q, char *err) {
+    const char *p = text;
+
+    memset(q, 0, sizeof(QUERY));
+    for (;;) {
+        while (*p == ',' || *p == ' ') {
+            p++;
+        }
+        if (*p == '\0') {
+            return EXIT_SUCCESS;
+        }
+        int len = strcspn(p, ", ");
+        int negate = (*p == '!');
+        const char *t = p + negate;
+        int tlen = len - negate;
+        p += len;
+
+        // metal, or a list of alternatives
+        if ((tlen == 5 && strncmp(t, "metal", 5) == 0) || (!negate && memchr(t, '|', tlen) != NULL)) {
+            ELEMENTBITS b = { { 0, 0 } };
+            if (tlen == 5 && strncmp(t, "metal", 5) == 0) {
+                b = metals(h);
+            } else {
+                for (int i = 0; i < tlen; ) {
+                    int n = 0;
+                    while (i + n < tlen && t[i + n] != '|') {
+                        n++;
+                    }
+                    int slot = findSymbol(h, t + i, n);
+                    if (slot < 0) {
+                        snprintf(err, CHEM_ERROR_SIZE, "unknown element %.*s", n, t + i);
+                        return CHEM_BAD_ARGUMENT;
+                    }
+                    setBit(&b, slot);
+                    i += n + 1;
+                }
+            }
+            if (negate) {
+                q->none.w[0] |= b.w[0];
+                q->none.w[1] |= b.w[1];
+            } else if (q->needAny) {
+                snprintf(err, CHEM_ERROR_SIZE, "only one list of alternatives (or metal) per query");
+                return CHEM_BAD_ARGUMENT;
+            } else {
+                q->any = b;
+                q->needAny = 1;
+            }
+            continue;
+        }
+
+        // An element, with an optional count condition
+        int n = 0;
+        while (n < tlen && ((t[n] >= 'A' && t[n] <= 'Z') || (t[n] >= 'a' && t[n] <= 'z'))) {
+            n++;
+        }
+        int slot = findSymbol(h, t, n);
+        if (slot < 0) {
+            snprintf(err, CHEM_ERROR_SIZE, "unknown element %.*s", n, t);
+            return CHEM_BAD_ARGUMENT;
+        }
+        if (n == tlen) {
+            setBit(negate ? &q->none : &q->all, slot);
+            continue;
+        }
+
+        COUNTTERM c = { slot, 0, 0 };
+        const char *o = t + n;
+        int olen = (o[1] == '=') ? 2 : 1;
+        c.op = (o[0] == '=') ? '=' : (o[0] == '!' && olen == 2) ? '!' : (o[0] == '<') ? ((olen == 2) ? 'l' : '<') :
+               (o[0] == '>') ? ((olen == 2) ? 'g' : '>') : 0;
+        char *end;
+        c.value = strtoll(o + olen, &end, 10);
+        if (negate || c.op == 0 || (c.op == '=' && olen == 2) || o[olen] < '0' || o[olen] > '9' || end != t + tlen) {
+            snprintf(err, CHEM_ERROR_SIZE, "invalid term %.*s", len, t - negate);
+            return CHEM_BAD_ARGUMENT;
+        }
+
+        // Conditions that only hold with the element absent, or that need it present, go into the masks
+        int settled = 0;
+        if ((c.op == 'l' || c.op == '=') ? (c.value == 0) : (c.op == '<') ? (c.value == 1) : 0) {
+            setBit(&q->none, slot);
+            settled = 1;
+        } else {
+            if ((c.op == 'g' || c.op == '=') ? (c.value >= 1) : (c.op == '>') ? 1 : (c.op == '!') ? (c.value == 0) : 0) {
+                setBit(&q->all, slot);
+            }
+            settled = (c.op == 'g' && c.value == 1) || (c.op == '>' && c.value == 0) || (c.op == '!' && c.value == 0);
+        }
+        if (!settled) {
+            if (q->terms == QUERY_TERMS) {
+                snprintf(err, CHEM_ERROR_SIZE, "more than %d count conditions", QUERY_TERMS);
+                return CHEM_BAD_ARGUMENT;
+            }
+            q->term[q->terms++] = c; // The masks do not settle it
+        }
+    }
+}
+
+/**
+ * @brief Tests the count conditions of a query on a record that matches its masks.
+ *
+ * The atoms of an element are found by its rank among the elements present.
+ */
+static int matchTerms(const QUERY *q, const ELEMENTBITS *b, const int64_t *atoms) {
+    for (int t = 0; t < q->terms; t++) {
+        const COUNTTERM *c = &q->term[t];
+        int word = c->slot >> 6;
+        uint64_t bit = 1ULL << (c->slot & 63);
+        long long value = 0;
+        if (b->w[word] & bit) {
+            int rank = __builtin_popcountll(b->w[word] & (bit - 1)) + ((word == 1) ? __builtin_popcountll(b->w[0]) : 0);
+            value = atoms[rank];
+        }
+        int ok = (c->op == '<') ? (value < c->value) : (c->op == 'l') ? (value <= c->value) :
+                 (c->op == '=') ? (value == c->value) : (c->op == '!') ? (value != c->value) :
+                 (c->op == 'g') ? (value >= c->value) : (value > c->value);
+        if (!ok) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Writes the line numbers of the formulas of an index that match a query.
+ *
+ * The index is mapped and its records are walked in order. Most records are settled
+ * by the masks of the query, tested on both 64-bit words of the record at once;
+ * the atoms are only read for the records that pass them and have count conditions.
+ * No formula is parsed again.
+ *
+ * @param path The index file (built with `-index`).
+ * @param text The query (see `parseQuery`).
+ * @param out The writer that receives the matching line numbers, one per line.
+ * @param records Receives the number of formulas in the index.
+ * @param matches Receives the number of matching formulas.
+ * @param err Receives the reason if the index or the query is invalid (`CHEM_ERROR_SIZE` bytes).
+ * @return int Returns EXIT_SUCCESS, EXIT_FAILURE if the index cannot be opened or mapped (see errno),
+ *         or CHEM_BAD_ARGUMENT if the index or the query is invalid.
+ */
+int queryIndex(const char *path, const char *text, WRITER *out, long *records, long *matches, char *err) {
+    struct stat st;
+    QUERY q;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        return EXIT_FAILURE;
+    }
+    size_t size = st.st_size;
+    if (size < sizeof(INDEXHEADER)) {
+        close(fd);
+        snprintf(err, CHEM_ERROR_SIZE, "%s is not an index", path);
+        return CHEM_BAD_ARGUMENT;
+    }
+    const char *data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return EXIT_FAILURE;
+    }
+    madvise((void *)data, size, MADV_SEQUENTIAL);
+
+    const INDEXHEADER *h = (const INDEXHEADER *)data;
+    int flag = EXIT_SUCCESS;
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) != 0 || h->elements != N || h->version != 1) {
+        snprintf(err, CHEM_ERROR_SIZE, "%s is not an index of this version", path);
+        flag = CHEM_BAD_ARGUMENT;
+    } else {
+        flag = parseQuery(text, h, &q, err);
+    }
+
+    *records = 0;
+    *matches = 0;
+    size_t pos = sizeof(INDEXHEADER);
+    const uint64_t failed = 1ULL << (INDEX_FAILED - 64);
+    while (flag == EXIT_SUCCESS && pos < size) {
+        const ELEMENTBITS *b = (const ELEMENTBITS *)(data + pos);
+        const int64_t *atoms = (const int64_t *)(b + 1);
+        int present = 0;
+
+        pos += sizeof(ELEMENTBITS);
+        if (pos <= size && !(b->w[1] & failed)) {
+            present = __builtin_popcountll(b->w[0]) + __builtin_popcountll(b->w[1]);
+            pos += present * sizeof(int64_t);
+        }
+        if (pos > size) {
+            snprintf(err, CHEM_ERROR_SIZE, "%s is truncated", path);
+            flag = CHEM_BAD_ARGUMENT;
+            break;
+        }
+        (*records)++;
+
+        // All the masks, on both words at once
+        uint64_t miss = ((b->w[0] & q.all.w[0]) ^ q.all.w[0]) | ((b->w[1] & q.all.w[1]) ^ q.all.w[1]) |
+                        (b->w[0] & q.none.w[0]) | (b->w[1] & (q.none.w[1] | failed));
+        if (miss != 0 || (q.needAny && ((b->w[0] & q.any.w[0]) | (b->w[1] & q.any.w[1])) == 0)) {
+            continue;
+        }
+        if (q.terms > 0 && !matchTerms(&q, b, atoms)) {
+            continue;
+        }
+        writeInt(out, *records);
+        writeChar(out, '\n');
+        (*matches)++;
+    }
+
+    munmap((void *)data, size);
+    return flag;
+}
@@ -0,0 +1,68 @@
+#ifndef ELEMENT_INDEX
+#define ELEMENT_INDEX
+
+#include <stdint.h>
+#include "periodicTable.h" // Include the periodic table definition
+#include "writer.h"
+
+#define INDEX_MAGIC "PFINDEX1"  ///< First bytes of an index file
+#define INDEX_FAILED 127        ///< Bit of the records of the formulas that could not be counted
+#define QUERY_TERMS 32          ///< Most count conditions in a query
+
+/**
+ * @brief The elements present in a formula, one bit per slot of the periodic table.
+ *
+ * The slots fit in 128 bits, so a test against a whole set of elements is two
+ * 64-bit operations, which the compiler combines into one SSE operation.
+ */
+typedef struct {
+    uint64_t w[2];          ///< Slots 0-63, then slots 64-127
+} ELEMENTBITS;
+
+/**
+ * @brief Header of an index file.
+ *
+ * It holds the symbols and atomic numbers of the table the index was built with,
+ * so it can be queried without the table. It is followed by one record per formula
+ * of the input, in order: an `ELEMENTBITS`, then the atoms of every element present,
+ * as 64-bit integers in the order of the slots. The record of a formula that could not
+ * be counted only has the `INDEX_FAILED` bit set.
+ */
+typedef struct {
+    char magic[8];          ///< INDEX_MAGIC, without its null character
+    uint32_t elements;      ///< Number of slots of the table (N)
+    uint32_t version;       ///< Format version (1)
+    int32_t anum[N];        ///< The atomic numbers of the table
+    char ch[N][3];          ///< The symbols of the table
+    char pad[6];            ///< Keeps the header a multiple of 8 bytes
+} INDEXHEADER;
+
+/**
+ * @brief A condition on the atoms of one element, such as `O>=3`.
+ */
+typedef struct {
+    int slot;               ///< The element
+    char op;                ///< '<', 'l' (<=), '=', '!' (!=), 'g' (>=) or '>'
+    long long value;        ///< The number of atoms it is compared with
+} COUNTTERM;
+
+/**
+ * @brief A query, compiled into masks that are tested against the records of an index.
+ */
+typedef struct {
+    ELEMENTBITS all;        ///< Elements that must all be present
+    ELEMENTBITS none;       ///< Elements that must all be absent
+    ELEMENTBITS any;        ///< At least one of them must be present (when `needAny` is set)
+    int needAny;            ///< 1 if `any` is used
+    int terms;              ///< Number of count conditions
+    COUNTTERM term[QUERY_TERMS]; ///< The count conditions, tested on the records that match the masks
+} QUERY;
+
+
+void writeIndexHeader(WRITER *out, const PTABLE * const pert);
+void writeIndexRecord(WRITER *out, const long long counts[N]);
+void writeIndexFailed(WRITER *out);
+int parseQuery(const char *text, const INDEXHEADER *h, QUERY *q, char *err);
+int queryIndex(const char *path, const char *text, WRITER *out, long *records, long *matches, char *err);
+
+#endif // ELEMENT_INDEX
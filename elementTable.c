@@ -0,0 +1,142 @@
+#include "periodicTable.h"
+
+/**
+ * @brief The periodic table that is compiled into the program.
+ *
+ * It holds the same data as the table file of the assignment (symbol and atomic
+ * number of the 118 elements, in order), together with the symbol index, so no
+ * file has to be read or parsed at startup. An index entry is the slot of the
+ * symbol plus one; the entries that are left out are 0 (not in the table).
+ *
+ * The property columns hold the standard atomic weight (the mass number of the
+ * longest-lived isotope for the elements without one), the atomic number, the
+ * electrons of the neutral atom and the valence electrons: the group number in
+ * the s and d blocks (3 for the lanthanides and actinides), the group number
+ * minus 10 in the p block, and 2 for helium.
+ */
+const PTABLE builtinTable = {
+    .ch = {
+        "H", "He", "Li", "Be", "B", "C", "N", "O", "F", "Ne", "Na", "Mg", "Al", "Si", "P", "S",
+        "Cl", "Ar", "K", "Ca", "Sc", "Ti", "V", "Cr", "Mn", "Fe", "Co", "Ni", "Cu", "Zn", "Ga",
+        "Ge", "As", "Se", "Br", "Kr", "Rb", "Sr", "Y", "Zr", "Nb", "Mo", "Tc", "Ru", "Rh", "Pd",
+        "Ag", "Cd", "In", "Sn", "Sb", "Te", "I", "Xe", "Cs", "Ba", "La", "Ce", "Pr", "Nd", "Pm",
+        "Sm", "Eu", "Gd", "Tb", "Dy", "Ho", "Er", "Tm", "Yb", "Lu", "Hf", "Ta", "W", "Re", "Os",
+        "Ir", "Pt", "Au", "Hg", "Tl", "Pb", "Bi", "Po", "At", "Rn", "Fr", "Ra", "Ac", "Th",
+        "Pa", "U", "Np", "Pu", "Am", "Cm", "Bk", "Cf", "Es", "Fm", "Md", "No", "Lr", "Rf", "Db",
+        "Sg", "Bh", "Hs", "Mt", "Ds", "Rg", "Cn", "Nh", "Fl", "Mc", "Lv", "Ts", "Og",
+    },
+    .anum = {
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+        25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+        47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
+        69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90,
+        91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109,
+        110, 111, 112, 113, 114, 115, 116, 117, 118,
+    },
+    .prop = {
+        [PROP_MASS] = {
+            1.008, 4.0026, 6.94, 9.0122, 10.81, 12.011, 14.007, 15.999, 18.998, 20.180, 22.990,
+            24.305, 26.982, 28.085, 30.974, 32.06, 35.45, 39.948, 39.098, 40.078, 44.956, 47.867,
+            50.942, 51.996, 54.938, 55.845, 58.933, 58.693, 63.546, 65.38, 69.723, 72.630, 74.922,
+            78.971, 79.904, 83.798, 85.468, 87.62, 88.906, 91.224, 92.906, 95.95, 98, 101.07,
+            102.91, 106.42, 107.87, 112.41, 114.82, 118.71, 121.76, 127.60, 126.90, 131.29, 132.91,
+            137.33, 138.91, 140.12, 140.91, 144.24, 145, 150.36, 151.96, 157.25, 158.93, 162.50,
+            164.93, 167.26, 168.93, 173.05, 174.97, 178.49, 180.95, 183.84, 186.21, 190.23, 192.22,
+            195.08, 196.97, 200.59, 204.38, 207.2, 208.98, 209, 210, 222, 223, 226, 227, 232.04,
+            231.04, 238.03, 237, 244, 243, 247, 247, 251, 252, 257, 258, 259, 266, 267, 268, 269,
+            270, 269, 278, 281, 282, 285, 286, 289, 290, 293, 294, 294,
+        },
+        [PROP_ANUM] = {
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+            25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+            47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
+            69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90,
+            91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109,
+            110, 111, 112, 113, 114, 115, 116, 117, 118,
+        },
+        [PROP_ELECTRONS] = {
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+            25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+            47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
+            69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90,
+            91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109,
+            110, 111, 112, 113, 114, 115, 116, 117, 118,
+        },
+        [PROP_VALENCE] = {
+            1, 2, 1, 2, 3, 4, 5, 6, 7, 8, 1, 2, 3, 4, 5, 6, 7, 8, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+            12, 3, 4, 5, 6, 7, 8, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 3, 4, 5, 6, 7, 8, 1, 2, 3,
+            3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 3, 4, 5, 6, 7,
+            8, 1, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 3,
+            4, 5, 6, 7, 8,
+        },
+    },
+    .index = {
+        ['A' - 'A'] = {
+            ['c' - 'a' + 1] = 89, ['g' - 'a' + 1] = 47, ['l' - 'a' + 1] = 13, ['m' - 'a' + 1] = 95,
+            ['r' - 'a' + 1] = 18, ['s' - 'a' + 1] = 33, ['t' - 'a' + 1] = 85, ['u' - 'a' + 1] = 79
+        },
+        ['B' - 'A'] = {
+            [0] = 5, ['a' - 'a' + 1] = 56, ['e' - 'a' + 1] = 4, ['h' - 'a' + 1] = 107,
+            ['i' - 'a' + 1] = 83, ['k' - 'a' + 1] = 97, ['r' - 'a' + 1] = 35
+        },
+        ['C' - 'A'] = {
+            [0] = 6, ['a' - 'a' + 1] = 20, ['d' - 'a' + 1] = 48, ['e' - 'a' + 1] = 58,
+            ['f' - 'a' + 1] = 98, ['l' - 'a' + 1] = 17, ['m' - 'a' + 1] = 96,
+            ['n' - 'a' + 1] = 112, ['o' - 'a' + 1] = 27, ['r' - 'a' + 1] = 24,
+            ['s' - 'a' + 1] = 55, ['u' - 'a' + 1] = 29
+        },
+        ['D' - 'A'] = { ['b' - 'a' + 1] = 105, ['s' - 'a' + 1] = 110, ['y' - 'a' + 1] = 66 },
+        ['E' - 'A'] = { ['r' - 'a' + 1] = 68, ['s' - 'a' + 1] = 99, ['u' - 'a' + 1] = 63 },
+        ['F' - 'A'] = {
+            [0] = 9, ['e' - 'a' + 1] = 26, ['l' - 'a' + 1] = 114, ['m' - 'a' + 1] = 100,
+            ['r' - 'a' + 1] = 87
+        },
+        ['G' - 'A'] = { ['a' - 'a' + 1] = 31, ['d' - 'a' + 1] = 64, ['e' - 'a' + 1] = 32 },
+        ['H' - 'A'] = {
+            [0] = 1, ['e' - 'a' + 1] = 2, ['f' - 'a' + 1] = 72, ['g' - 'a' + 1] = 80,
+            ['o' - 'a' + 1] = 67, ['s' - 'a' + 1] = 108
+        },
+        ['I' - 'A'] = { [0] = 53, ['n' - 'a' + 1] = 49, ['r' - 'a' + 1] = 77 },
+        ['K' - 'A'] = { [0] = 19, ['r' - 'a' + 1] = 36 },
+        ['L' - 'A'] = {
+            ['a' - 'a' + 1] = 57, ['i' - 'a' + 1] = 3, ['r' - 'a' + 1] = 103, ['u' - 'a' + 1] = 71,
+            ['v' - 'a' + 1] = 116
+        },
+        ['M' - 'A'] = {
+            ['c' - 'a' + 1] = 115, ['d' - 'a' + 1] = 101, ['g' - 'a' + 1] = 12,
+            ['n' - 'a' + 1] = 25, ['o' - 'a' + 1] = 42, ['t' - 'a' + 1] = 109
+        },
+        ['N' - 'A'] = {
+            [0] = 7, ['a' - 'a' + 1] = 11, ['b' - 'a' + 1] = 41, ['d' - 'a' + 1] = 60,
+            ['e' - 'a' + 1] = 10, ['h' - 'a' + 1] = 113, ['i' - 'a' + 1] = 28,
+            ['o' - 'a' + 1] = 102, ['p' - 'a' + 1] = 93
+        },
+        ['O' - 'A'] = { [0] = 8, ['g' - 'a' + 1] = 118, ['s' - 'a' + 1] = 76 },
+        ['P' - 'A'] = {
+            [0] = 15, ['a' - 'a' + 1] = 91, ['b' - 'a' + 1] = 82, ['d' - 'a' + 1] = 46,
+            ['m' - 'a' + 1] = 61, ['o' - 'a' + 1] = 84, ['r' - 'a' + 1] = 59, ['t' - 'a' + 1] = 78,
+            ['u' - 'a' + 1] = 94
+        },
+        ['R' - 'A'] = {
+            ['a' - 'a' + 1] = 88, ['b' - 'a' + 1] = 37, ['e' - 'a' + 1] = 75,
+            ['f' - 'a' + 1] = 104, ['g' - 'a' + 1] = 111, ['h' - 'a' + 1] = 45,
+            ['n' - 'a' + 1] = 86, ['u' - 'a' + 1] = 44
+        },
+        ['S' - 'A'] = {
+            [0] = 16, ['b' - 'a' + 1] = 51, ['c' - 'a' + 1] = 21, ['e' - 'a' + 1] = 34,
+            ['g' - 'a' + 1] = 106, ['i' - 'a' + 1] = 14, ['m' - 'a' + 1] = 62,
+            ['n' - 'a' + 1] = 50, ['r' - 'a' + 1] = 38
+        },
+        ['T' - 'A'] = {
+            ['a' - 'a' + 1] = 73, ['b' - 'a' + 1] = 65, ['c' - 'a' + 1] = 43, ['e' - 'a' + 1] = 52,
+            ['h' - 'a' + 1] = 90, ['i' - 'a' + 1] = 22, ['l' - 'a' + 1] = 81, ['m' - 'a' + 1] = 69,
+            ['s' - 'a' + 1] = 117
+        },
+        ['U' - 'A'] = { [0] = 92 },
+        ['V' - 'A'] = { [0] = 23 },
+        ['W' - 'A'] = { [0] = 74 },
+        ['X' - 'A'] = { ['e' - 'a' + 1] = 54 },
+        ['Y' - 'A'] = { [0] = 39, ['b' - 'a' + 1] = 70 },
+        ['Z' - 'A'] = { ['n' - 'a' + 1] = 30, ['r' - 'a' + 1] = 40 },
+    },
+};
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "reader.h"
+#include "writer.h"
+
+#define REQUEST_LINES 4096  ///< Default number of formulas sent in one request
+
+/**
+ * @brief What the sending thread needs to turn the input file into requests.
+ */
+typedef struct {
+    int fd;                 ///< The connection to the server
+    READER *in;             ///< The input file
+    const char *mode;       ///< The mode of the requests (-v, -ext, -pn, -mass or -props)
+    const char *list;       ///< The properties of -props, or NULL
+    int lines;              ///< Formulas per request
+    int flag;               ///< EXIT_FAILURE if the requests could not be sent
+} SENDER;
+
+/**
+ * @brief Thread that sends the formulas of the input file as requests.
+ *
+ * The requests are written without waiting for the answers (pipelined), so the
+ * server always has the next batch at hand while the answers are read.
+ */
+static void *sendRequests(void *arg) {
+    SENDER *s = (SENDER *)arg;
+    WRITER *req = fdWriter(s->fd, WRITE_SIZE);
+    WRITER *body = memoryWriter(WRITE_SIZE);
+    const char *chem;
+    size_t len;
+    int line = 1, more = 1;
+
+    s->flag = EXIT_FAILURE;
+    if (req == NULL || body == NULL) {
+        perror("Memory allocation failed");
+        goto done;
+    }
+
+    while (more) {
+        int count = 0;
+        body->len = 0;
+        while (count < s->lines && (more = nextFormula(s->in, &chem, &len))) {
+            writeBytes(body, chem, len);
+            writeChar(body, '\n');
+            releaseFormulas(s->in);
+            count++;
+        }
+        if (count == 0) {
+            break;
+        }
+        writeString(req, s->mode);
+        if (s->list != NULL) {
+            writeChar(req, ' ');
+            writeString(req, s->list);
+        }
+        writeChar(req, ' ');
+        writeInt(req, body->len);
+        writeChar(req, ' ');
+        writeInt(req, line);
+        writeChar(req, '\n');
+        writeBytes(req, body->buf, body->len);
+        line += count;
+    }
+    if (flushWriter(req) == EXIT_SUCCESS && !body->error) {
+        s->flag = EXIT_SUCCESS;
+    }
+
+done:
+    shutdown(s->fd, SHUT_WR); // No more requests; the server ends the answers
+    if (req != NULL) closeWriter(req);
+    if (body != NULL) closeWriter(body);
+    return NULL;
+}
+
+/**
+ * @brief Copies `len` bytes of an answer to a writer (or skips them if it is NULL).
+ *
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE if the answer ends early.
+ */
+static int copyAnswer(FILE *from, size_t len, WRITER *to) {
+    char buf[1 << 16];
+
+    while (len > 0) {
+        size_t n = fread(buf, 1, (len < sizeof(buf)) ? len : sizeof(buf), from);
+        if (n == 0) {
+            return EXIT_FAILURE;
+        }
+        if (to != NULL) {
+            writeBytes(to, buf, n);
+        }
+        len -= n;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Small client of `parseFormula --serve`, to try the server out locally.
+ *
+ * It sends the formulas of the input file to the server in batches and writes
+ * the answers like parseFormula would: the results to the output file and the
+ * messages to the console (stderr when the results go to the standard output).
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv The array of command-line arguments.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int main(int argc, char *argv[]) {
+    SENDER s = { .lines = REQUEST_LINES };
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    char header[256];
+    int n = 1, flag = EXIT_SUCCESS;
+
+    // Take -n out of the arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            s.lines = atoi(argv[++i]);
+            if (s.lines < 1) {
+                fprintf(stderr, "Invalid number of formulas per request: %s\n", argv[i]);
+                return -1;
+            }
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+    argc = n;
+
+    int files = 3; // Index of the input file
+    if (argc > 2 && strcmp(argv[2], "-props") == 0) {
+        s.list = (argc > 3) ? argv[3] : NULL;
+        files = 4;
+    }
+    if (argc <= files || (strcmp(argv[2], "-v") != 0 && argc <= files + 1)) {
+        printf("Usage: %s <socket> (-v | -ext | -pn | -mass | -props <list>) <input_file> [<output_file>] [-n <formulas per request>] "
+               "(a file named - is the standard input or output)\n", argv[0]);
+        return -1;
+    }
+    s.mode = argv[2];
+
+    s.in = openReader(argv[files]);
+    if (s.in == NULL) {
+        perror("Unable to open input file");
+        return -1;
+    }
+
+    // The results go to the output file; the messages go to the console
+    FILE *out = NULL, *console = stdout;
+    if (argc > files + 1) {
+        if (strcmp(argv[files + 1], "-") == 0) {
+            out = stdout;
+            console = stderr;
+        } else if ((out = fopen(argv[files + 1], "w")) == NULL) {
+            perror("Unable to open output file");
+            return -1;
+        }
+    }
+    WRITER *res = (out != NULL) ? fdWriter(fileno(out), WRITE_SIZE) : NULL;
+    WRITER *msg = fileWriter(console, WRITE_SIZE);
+    if ((out != NULL && res == NULL) || msg == NULL) {
+        perror("Memory allocation failed");
+        return -1;
+    }
+
+    if (strlen(argv[1]) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", argv[1]);
+        return -1;
+    }
+    strcpy(addr.sun_path, argv[1]);
+    s.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s.fd < 0 || connect(s.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("Unable to connect to the server");
+        return -1;
+    }
+    FILE *answers = fdopen(dup(s.fd), "r");
+    if (answers == NULL) {
+        perror("Unable to read from the server");
+        return -1;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // A server that goes away is a write error, reported below
+
+    pthread_t sender;
+    if (pthread_create(&sender, NULL, sendRequests, &s) != 0) {
+        perror("Unable to create thread");
+        return -1;
+    }
+
+    // Read the answers, in the order of the requests
+    while (fgets(header, sizeof(header), answers) != NULL) {
+        size_t outLen, msgLen;
+        if (sscanf(header, "OK %zu %zu", &outLen, &msgLen) != 2) {
+            fprintf(stderr, "Server error: %s", (strncmp(header, "ERR ", 4) == 0) ? header + 4 : header);
+            flag = EXIT_FAILURE;
+            break;
+        }
+        if (copyAnswer(answers, outLen, res) == EXIT_FAILURE || copyAnswer(answers, msgLen, msg) == EXIT_FAILURE) {
+            fprintf(stderr, "Incomplete answer from the server\n");
+            flag = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    pthread_join(sender, NULL);
+    if (s.flag == EXIT_FAILURE) {
+        perror("Unable to send the formulas");
+        flag = EXIT_FAILURE;
+    }
+    fclose(answers);
+    close(s.fd);
+    closeReader(s.in);
+    if (res != NULL && closeWriter(res) == EXIT_FAILURE) {
+        perror("Unable to write output file");
+        flag = EXIT_FAILURE;
+    }
+    closeWriter(msg);
+    if (out != NULL && out != stdout) {
+        fclose(out);
+    }
+    return (flag == EXIT_SUCCESS) ? 0 : -1;
+}
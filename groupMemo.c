@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "groupMemo.h"
+#include "hash.h"
+
+/**
+ * @brief Creates an empty group memo.
+ *
+ * @param size The maximum number of group bodies to remember (1 to MEMO_MAX).
+ * @return GROUPMEMO* The memo, or NULL if the size is out of range or memory allocation fails.
+ */
+GROUPMEMO *createMemo(int size) {
+    if (size < 1 || size > MEMO_MAX) {
+        return NULL;
+    }
+    GROUPMEMO *g = (GROUPMEMO *)calloc(1, sizeof(GROUPMEMO));
+    if (g == NULL) {
+        return NULL;
+    }
+    g->size = size;
+    g->nbuckets = 1;
+    while (g->nbuckets < size) {
+        g->nbuckets *= 2;
+    }
+    g->nbuckets *= 2; // At most half full
+    g->entries = (MEMO *)calloc(size, sizeof(MEMO));
+    g->buckets = (int *)malloc(g->nbuckets * sizeof(int));
+    if (g->entries == NULL || g->buckets == NULL) {
+        freeMemo(g);
+        return NULL;
+    }
+    memset(g->buckets, -1, g->nbuckets * sizeof(int));
+    return g;
+}
+
+/**
+ * @brief Looks up the composition of a group body.
+ *
+ * @param g The memo.
+ * @param body The text between '(' and ')'.
+ * @param len The length of the body.
+ * @return const MEMO* The entry of the body, or NULL if it has not been seen. The caller counts
+ *         it in `hits` if it uses it (an entry without atoms cannot give a composition).
+ */
+const MEMO *findMemo(GROUPMEMO *g, const char *body, int len) {
+    unsigned long h = hashBytes(HASH_START, body, len);
+
+    for (int e = g->buckets[h & (g->nbuckets - 1)]; e >= 0; e = g->entries[e].next) {
+        MEMO *p = &g->entries[e];
+        if (p->hash == h && p->klen == len && memcmp(p->key, body, len) == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Forgets every group body.
+ */
+static void clearMemo(GROUPMEMO *g) {
+    for (int e = 0; e < g->count; e++) {
+        free(g->entries[e].atoms);
+        g->entries[e].atoms = NULL;
+    }
+    g->count = 0;
+    memset(g->buckets, -1, g->nbuckets * sizeof(int));
+}
+
+/**
+ * @brief Remembers the composition of a group body.
+ *
+ * @param g The memo.
+ * @param body The text between '(' and ')'.
+ * @param len The length of the body.
+ * @param sum The total atomic number of one copy of the group.
+ * @param natoms The number of element counts of the group, which the caller stores in
+ *        `atoms` of the returned entry, or -1 if only the total is known.
+ * @return MEMO* The new entry, or NULL if memory allocation fails.
+ */
+MEMO *addMemo(GROUPMEMO *g, const char *body, int len, long long sum, int natoms) {
+    if (g->count == g->size) {
+        clearMemo(g); // Full: start over
+    }
+
+    size_t atomBytes = (natoms > 0) ? natoms * sizeof(MEMOATOM) : 0;
+    char *block = (char *)malloc(atomBytes + len + 1); // The atoms followed by the body
+    if (block == NULL) {
+        return NULL;
+    }
+
+    MEMO *p = &g->entries[g->count];
+    p->atoms = (MEMOATOM *)block; // The whole block is freed through `atoms`
+    p->key = block + atomBytes;
+    memcpy(p->key, body, len);
+    p->klen = len;
+    p->hash = hashBytes(HASH_START, body, len);
+    p->sum = sum;
+    p->natoms = natoms;
+
+    int *bucket = &g->buckets[p->hash & (g->nbuckets - 1)];
+    p->next = *bucket;
+    *bucket = g->count++;
+    return p;
+}
+
+/**
+ * @brief Finds the matching ')' of every '(' of a formula.
+ *
+ * The positions are stored in `g->match` (only the entries of '(' are set), so
+ * that a parser can look a group body up before it parses it.
+ *
+ * @param g The memo that owns the scratch array.
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @return int EXIT_SUCCESS, EXIT_FAILURE if the parentheses are unbalanced, or -1 if memory runs out.
+ */
+int matchGroups(GROUPMEMO *g, const char *chem, int length) {
+    if (length > g->matchSize) {
+        int *temp = (int *)realloc(g->match, length * sizeof(int));
+        if (temp == NULL) {
+            return -1;
+        }
+        g->match = temp;
+        g->matchSize = length;
+    }
+
+    // The open '(' are chained through their own entries, so no extra stack is needed
+    int open = -1;
+    for (int i = 0; i < length; i++) {
+        if (chem[i] == '(') {
+            g->match[i] = open;
+            open = i;
+        } else if (chem[i] == ')') {
+            if (open < 0) {
+                return EXIT_FAILURE; // No matching '('
+            }
+            int outer = g->match[open];
+            g->match[open] = i;
+            open = outer;
+        }
+    }
+    return (open < 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Releases the memo.
+ */
+void freeMemo(GROUPMEMO *g) {
+    if (g == NULL) return;
+    if (g->entries != NULL && g->buckets != NULL) {
+        clearMemo(g);
+    }
+    free(g->entries);
+    free(g->buckets);
+    free(g->match);
+    free(g);
+}
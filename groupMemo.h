@@ -0,0 +1,54 @@
+#ifndef GROUP_MEMO
+#define GROUP_MEMO
+
+#include <limits.h>
+
+#define MEMO_MIN_BODY 4     ///< Shorter group bodies are cheaper to parse than to look up
+#define MEMO_MAX (INT_MAX / 4) ///< Most entries of a memo, so its bucket count fits in an int
+
+/**
+ * @brief Number of atoms of one element inside a remembered group.
+ */
+typedef struct {
+    int slot;         ///< Index of the element in the `PTABLE`
+    long long count;  ///< Number of atoms of the element in one copy of the group
+} MEMOATOM;
+
+/**
+ * @brief The composition of one distinct group body (the text between '(' and ')').
+ */
+typedef struct {
+    char *key;          ///< The group body (not null-terminated)
+    int klen;           ///< Length of the group body
+    unsigned long hash; ///< Hash of the group body
+    int next;           ///< Next entry of the same bucket, or -1
+    long long sum;      ///< Total atomic number of one copy of the group
+    int natoms;         ///< Number of elements in `atoms`, or -1 if only `sum` is known
+    MEMOATOM *atoms;    ///< Element counts of one copy of the group
+} MEMO;
+
+/**
+ * @brief Compositions of the group bodies a parser has already evaluated.
+ *
+ * When the table is full it is emptied and starts over, which keeps it bounded
+ * while still serving the groups that repeat inside the formulas of a batch.
+ */
+typedef struct {
+    MEMO *entries;      ///< The entries
+    int size;           ///< Maximum number of entries
+    int count;          ///< Number of entries in use
+    int *buckets;       ///< First entry of every bucket, or -1
+    int nbuckets;       ///< Number of buckets (a power of 2)
+    int *match;         ///< Scratch: position of the matching ')' of every '(' of a formula
+    int matchSize;      ///< Size of `match`
+    long hits;          ///< Number of groups that were not parsed again
+} GROUPMEMO;
+
+
+GROUPMEMO *createMemo(int size);
+const MEMO *findMemo(GROUPMEMO *g, const char *body, int len);
+MEMO *addMemo(GROUPMEMO *g, const char *body, int len, long long sum, int natoms);
+int matchGroups(GROUPMEMO *g, const char *chem, int length);
+void freeMemo(GROUPMEMO *g);
+
+#endif // GROUP_MEMO
@@ -0,0 +1,25 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+
+#define HASH_START 14695981039346656037UL ///< FNV-1a offset basis, the hash of no bytes
+
+/**
+ * @brief FNV-1a hash of a run of bytes, continuing from the hash of the bytes before it.
+ *
+ * @param h HASH_START, or the hash of the preceding bytes (to hash data in several pieces).
+ * @param data The bytes.
+ * @param len The number of bytes.
+ * @return unsigned long The hash.
+ */
+static inline unsigned long hashBytes(unsigned long h, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+#endif // HASH_H
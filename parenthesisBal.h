@@ -2,6 +2,6 @@
 #define PAR_B
 
 
-int parB (char *chem);
+int parB (const char *chem, int length);
 
 #endif
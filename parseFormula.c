@@ -2,12 +2,127 @@
 #include <stdlib.h> 
 #include <string.h> 
 #include <stdbool.h> 
+#include <unistd.h>
+#include <errno.h>
 #include "periodicTable.h"
-#include "chemExt.h"
-#include "parenthesisBal.h"
-#include "protonNum.h"
-#include "stack.h"
-#define SIZE 50
+#include "batch.h"
+#include "cache.h"
+#include "server.h"
+#include "elementIndex.h"
+#include "hash.h"
+
+/**
+ * @brief Prints the counters of a run as a block of key=value lines.
+ *
+ * @param f Where the report is printed.
+ * @param phase The name of the function that processed the formulas.
+ * @param b The batch options and counters of the run.
+ * @param bytesIn The number of bytes read from the input file.
+ * @param bytesOut The number of bytes written to the output file.
+ * @param writeTime The seconds spent writing the output and the console messages.
+ */
+static void printStats(FILE *f, const char *phase, const BATCH *b, size_t bytesIn, size_t bytesOut, double writeTime) {
+    fprintf(f, "lines=%ld\n", b->totals.lines);
+    fprintf(f, "bytes_in=%zu\n", bytesIn);
+    fprintf(f, "bytes_out=%zu\n", bytesOut);
+    fprintf(f, "unbalanced=%ld\n", b->totals.unbalanced);
+    fprintf(f, "failed=%ld\n", b->totals.failed);
+    fprintf(f, "time_read=%.6f\n", b->totals.readTime);
+    fprintf(f, "time_%s=%.6f\n", phase, b->totals.processTime);
+    fprintf(f, "time_write=%.6f\n", writeTime);
+    fprintf(f, "stack_pushes=%ld\n", b->totals.pushes);
+    fprintf(f, "stack_pops=%ld\n", b->totals.pops);
+    fprintf(f, "buffer_grows=%ld\n", b->totals.bufferGrows);
+    fprintf(f, "max_expansion=%.2f\n", b->totals.ratio);
+    fprintf(f, "cache_hits=%ld\n", b->hits);
+    fprintf(f, "cache_misses=%ld\n", b->misses);
+    fprintf(f, "memo_hits=%ld\n", b->memoHits);
+}
+
+/**
+ * @brief Reads a number of entries from the command line.
+ *
+ * @param text The argument.
+ * @param most The largest number that is accepted.
+ * @param value Receives the number.
+ * @return int 1 if the argument is a whole number from 1 to `most`, 0 otherwise.
+ */
+static int readCount(const char *text, long most, int *value) {
+    char *end;
+    errno = 0;
+    long n = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || n < 1 || n > most) {
+        return 0;
+    }
+    *value = (int)n;
+    return 1;
+}
+
+/**
+ * @brief Names a file in the console messages, where `-` is the standard input or output.
+ */
+static const char *fileName(const char *path, const char *stdName) {
+    return (strcmp(path, "-") == 0) ? stdName : path;
+}
+
+/**
+ * @brief Loads the periodic table, or ends the program with the reason it could not.
+ *
+ * @param path The table file, or NULL for the built-in table.
+ * @return const PTABLE* The table.
+ */
+static const PTABLE *loadTable(const char *path) {
+    const PTABLE *pert;
+    char err[CHEM_ERROR_SIZE];
+
+    int status = createTable(path, &pert, err);
+    if (status == CHEM_NO_TABLE) {
+        perror("Unable to open file");
+        exit(-1);
+    } else if (status == CHEM_BAD_TABLE) {
+        fprintf(stderr, "Invalid periodic table %s, %s\n", path, err);
+        exit(-1);
+    } else if (status != CHEM_OK) {
+        perror("Memory allocation failed");
+        exit(-1);
+    }
+    return pert;
+}
+
+/**
+ * @brief Describes the options that shape the output of a run, for its checkpoints.
+ *
+ * A run can only continue an output file that was written with the same options.
+ * The modes that use the periodic table also record a hash of its contents, so a
+ * run with another table (or an edited table file) cannot continue it either.
+ *
+ * @param table The table file, or NULL for the built-in table.
+ */
+static void describeMode(char *mode, const char *opt, const char *list, MODE extend, const BUDGET *budget, const char *table) {
+    static const char *forms[] = { [RUNS] = " --compact runs", [HILL] = " --compact hill", [ATOMS] = " --stream" };
+    static const char *over[] = { [EXTEND] = "reject", [RUNS] = "runs", [HILL] = "hill" };
+    int n = snprintf(mode, CHECKPOINT_MODE, "%s", opt);
+
+    if (list != NULL) {
+        n += snprintf(mode + n, CHECKPOINT_MODE - n, " %s", list);
+    }
+    if (strcmp(opt, "-ext") != 0) {
+        const PTABLE *pert = loadTable(table);
+        unsigned long h = hashBytes(HASH_START, pert->ch, sizeof(pert->ch));
+        h = hashBytes(h, pert->anum, sizeof(pert->anum));
+        h = hashBytes(h, pert->prop, sizeof(pert->prop));
+        snprintf(mode + n, CHECKPOINT_MODE - n, " table=%016lx", h);
+        freeTable(pert);
+    } else {
+        if (extend != EXTEND) {
+            n += snprintf(mode + n, CHECKPOINT_MODE - n, "%s", forms[extend]);
+        }
+        if (budget->bytes > 0) {
+            snprintf(mode + n, CHECKPOINT_MODE - n, " --budget %zu --over-budget %s", budget->bytes, over[budget->over]);
+        }
+    }
+}
+
 /**
  * @brief Main function to process chemical formulas.
  * 
@@ -15,16 +130,166 @@
  * - `-v`: Verify if parentheses are balanced.
  * - `-ext`: Compute the extended version of the formulas and write to an output file.
  * - `-pn`: Compute the total proton number (atomic number) of formulas based on a periodic table.
+ * - `-mass`: Compute the molar mass of formulas.
+ * - `-props LIST`: Compute several properties of formulas in one parse; LIST is a comma-separated
+ *   list of mass, anum, electrons and valence, and the values are written in its order.
+ * - `-agg`: Add up the element counts of all the formulas and write one summary: the atoms
+ *   of every element, the distribution of the proton numbers and the largest formulas.
+ * - `-index`: Write a binary index with the elements present in every formula (a 128-bit
+ *   bitmap) and their atoms.
+ * - `-query INDEX QUERY`: Write the line numbers of the formulas of an index that match a
+ *   composition query such as `N,S,!metal` or `O>=3`; see elementIndex.c for the terms.
+ * - `--serve SOCKET`: Load the periodic table once and answer batches of formulas sent to the
+ *   Unix domain socket SOCKET (or on stdin/stdout with `-`); see server.h for the protocol.
+ * 
+ * The periodic table file before the option is optional; without it the table that is
+ * compiled into the program is used. An input or output file named `-` is the standard
+ * input or output; when the results go to the standard output, the console messages go
+ * to stderr so they do not mix with them.
+ * 
+ * The options may follow the file names:
+ * - `-j N`: process the formulas on N worker threads.
+ * - `-b BYTES`: size of the output buffer (default 1MB).
+ * - `--cache N`: remember the results of up to N distinct formulas (per worker thread).
+ * - `--memo N`: remember the compositions of up to N distinct groups (per worker thread, or
+ *   per connection with `--serve`).
+ * - `--compact runs|hill`: with `-ext`, write every formula as `symbol count` pairs instead
+ *   of one token per atom: the runs of the expansion in order, or the totals in Hill order.
+ * - `--stream`: with `-ext`, write the atoms of every formula as they are produced, separated by
+ *   single spaces, so an extended version of any size is written in chunks without being built.
+ *   It runs on one thread without the cache (`-j` and `--cache` are ignored).
+ * - `--budget BYTES`: with `-ext`, longest extended formula that is written; the exact length
+ *   is computed before a formula is expanded.
+ * - `--over-budget reject|runs|hill`: what happens to a formula over the budget: it is reported
+ *   as too large (the default), or written in the compact form of `--compact` (`hill` when
+ *   the runs are over the budget too).
+ * - `--checkpoint SECONDS`: every SECONDS seconds, record in `<output_file>.ckpt` how much
+ *   of the input has been processed and how much of the output belongs to it.
+ * - `--resume`: continue the run recorded in `<output_file>.ckpt` (with the same options and table):
+ *   the output is cut back to the checkpoint and the input is read from there. Without a
+ *   checkpoint the run starts from the beginning. It also saves checkpoints (every
+ *   `CHECKPOINT_SECONDS` seconds unless `--checkpoint` is given).
+ * - `--stats`: print the counters and timings of the run to stderr.
  * 
  * @param argc The number of command-line arguments.
  * @param argv The array of command-line arguments.
  * @return int Returns 0 on success, -1 on failure.
  */
 int main(int argc, char *argv[]) {
+    BATCH batch = { .jobs = 1, .budget = { 0, EXTEND } }; // Number of worker threads, cache size and counters
+    size_t bufSize = WRITE_SIZE; // Size of the output buffer
+    const char *phase = NULL; // The function that processes the formulas, for --stats
+    size_t bytesIn = 0, bytesOut = 0;
+    double writeTime = 0;
+    MODE extend = EXTEND; // The output form of -ext
+    const char *list = NULL; // The properties of -props
+    int resume = 0; // 1 to continue from the checkpoint of the output file
+    FILE *console = stdout; // Where the messages go (stderr when the results go to stdout)
+
+    // The table file is optional; without it the mode comes first and the built-in
+    // table is used, so shift the arguments to keep the mode at argv[2]
+    char *args[argc + 2];
+    if (argc > 1 && argv[1][0] == '-') {
+        args[0] = argv[0];
+        args[1] = NULL;
+        memcpy(&args[2], &argv[1], argc * sizeof(char *));
+        argv = args;
+        argc++;
+    }
+
+    // -mass is -props mass; the list of -props is taken out so the file names stay in place
+    if (argc > 2 && strcmp(argv[2], "-mass") == 0) {
+        parseProperties("mass", &batch.props);
+    } else if (argc > 2 && strcmp(argv[2], "-props") == 0) {
+        if (argc < 4 || parseProperties(argv[3], &batch.props) == EXIT_FAILURE) {
+            fprintf(stderr, "Invalid properties: %s (use a list of mass, anum, electrons, valence such as mass,anum)\n",
+                    (argc < 4) ? "" : argv[3]);
+            return -1;
+        }
+        list = argv[3];
+        memmove(&argv[3], &argv[4], (argc - 3) * sizeof(char *));
+        argc--;
+    }
+
+    // Take the options out of the arguments, keeping the file names in place
+    int n = 3;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            batch.jobs = atoi(argv[++i]);
+            if (batch.jobs < 1) {
+                fprintf(stderr, "Invalid number of jobs: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            long bytes = atol(argv[++i]);
+            if (bytes < 1) {
+                fprintf(stderr, "Invalid buffer size: %s\n", argv[i]);
+                return -1;
+            }
+            bufSize = bytes;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            if (!readCount(argv[++i], CACHE_MAX, &batch.cacheSize)) {
+                fprintf(stderr, "Invalid cache size: %s (use 1 to %d)\n", argv[i], CACHE_MAX);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--memo") == 0 && i + 1 < argc) {
+            if (!readCount(argv[++i], MEMO_MAX, &batch.memoSize)) {
+                fprintf(stderr, "Invalid memo size: %s (use 1 to %d)\n", argv[i], MEMO_MAX);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--compact") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "runs") == 0) {
+                extend = RUNS;
+            } else if (strcmp(argv[i], "hill") == 0) {
+                extend = HILL;
+            } else {
+                fprintf(stderr, "Invalid compact form: %s (use runs or hill)\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            extend = ATOMS;
+        } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            long long bytes = atoll(argv[++i]);
+            if (bytes < 1) {
+                fprintf(stderr, "Invalid budget: %s\n", argv[i]);
+                return -1;
+            }
+            batch.budget.bytes = bytes;
+        } else if (strcmp(argv[i], "--over-budget") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "reject") == 0) {
+                batch.budget.over = EXTEND;
+            } else if (strcmp(argv[i], "runs") == 0) {
+                batch.budget.over = RUNS;
+            } else if (strcmp(argv[i], "hill") == 0) {
+                batch.budget.over = HILL;
+            } else {
+                fprintf(stderr, "Invalid over-budget action: %s (use reject, runs or hill)\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            batch.interval = atof(argv[++i]);
+            if (!(batch.interval > 0)) {
+                fprintf(stderr, "Invalid checkpoint interval: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            batch.stats = 1;
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+    argc = n;
+
     // Check if sufficient command-line arguments are provided
     if (argc < 4) {
-        printf("Usage: %s -v <input_file> OR Usage: %s -ext <input_file> <output_file> OR "
-               "Usage: %s -pn <input_file> <output_file> \n", argv[0], argv[0], argv[0]);
+        printf("Usage: %s [table] -v <input_file> OR Usage: %s [table] -ext <input_file> <output_file> OR "
+               "Usage: %s [table] (-pn | -mass | -props <list> | -agg | -index) <input_file> <output_file> [-j <jobs>] [-b <bytes>] [--cache <entries>] [--memo <groups>] [--compact runs|hill] [--stream] [--budget <bytes>] [--over-budget reject|runs|hill] [--checkpoint <seconds>] [--resume] [--stats] OR "
+               "Usage: %s -query <index_file> <query> <output_file> OR "
+               "Usage: %s [table] --serve <socket> [--memo <groups>] (a file named - is the standard input or output)\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
         return -1;
     }
 
@@ -33,209 +298,277 @@ int main(int argc, char *argv[]) {
 
     // Check if the option is to verify balanced parentheses
     if (strcmp(opt, "-v") == 0) {
-        FILE *in;
-        in = fopen(argv[3], "r"); // Open the input file for reading
+        READER *in;
+        if (resume || batch.interval > 0) {
+            fprintf(stderr, "Checkpoints need the results in an output file\n");
+            exit(-1);
+        }
+        in = openReader(argv[3]); // Open the input file for reading
         if (in == NULL) {
             perror("Unable to open input file\n");
             exit(-1); // Exit if the file cannot be opened
         }
 
-        
-        char *chem;
-            chem=(char *)malloc (SIZE*sizeof(char)); // Allocate memory for the chemical formula
-    if (chem == NULL) {
-        perror("Memory allocation failed");
-        fclose(in);
-        exit(-1);
-    }
-        int flag, line = 1;
-        bool AllGood = true; // Flag to check if all formulas are balanced
-        int size=SIZE;
-        printf("Verify balanced parentheses in %s \n", argv[3]);
+        printf("Verify balanced parentheses in %s \n", fileName(argv[3], "standard input"));
         // Process each formula in the input file
-        while (fscanf(in, "%s", chem) != EOF) {
-        // Check if `chem` needs more space to hold the formula
-        if (sizeof(chem) >= size) {  // check if we need more memory space
-            size *= 2;  // Increase size 
-            char *temp = realloc(chem, size);
-            if (temp == NULL) {
-                fprintf(stderr, "Memory reallocation failed\n");
-                free(chem);
-                fclose(in);
-                return EXIT_FAILURE;
-            }
-            chem = temp;
+        WRITER *msg = fileWriter(stdout, bufSize);
+        if (msg == NULL) {
+            perror("Memory allocation failed");
+            exit(-1);
         }
-            flag = parB(chem); // Verify balanced parentheses in the formula
+        bool AllGood = (processFile(VERIFY, in, NULL, msg, NULL, &batch) == EXIT_SUCCESS);
+        flushWriter(msg);
+        writeTime = msg->seconds;
+        closeWriter(msg);
+        phase = "parB";
+        bytesIn = in->total;
 
-            // Check for errors and report unbalanced formulas
-            if (flag == EXIT_FAILURE) {
-                printf("Parentheses are NOT balanced in line: %d\n", line);
-                AllGood = false; // Mark as unbalanced
-            }
-            line++; // Increment line number
-        }
-        
         // Final report of balance status
         if (AllGood) 
             printf("Parentheses are balanced for all chemical formulas.\n");
         
-        free(chem); // Free memory for the chemical formula
-        fclose(in); // Close the input file
+        closeReader(in); // Close the input file
+    }
+    // Answer batches of formulas with the table loaded once
+    else if (strcmp(opt, "--serve") == 0) {
+        const PTABLE *pert = loadTable(argv[1]); // The table file, or the built-in table
+        int flag;
+
+        if (strcmp(argv[3], "-") == 0) {
+            flag = serveStream(STDIN_FILENO, STDOUT_FILENO, pert, batch.memoSize);
+        } else {
+            fprintf(stderr, "Serving formulas on %s\n", argv[3]);
+            flag = serveSocket(argv[3], pert, batch.memoSize);
+        }
+        freeTable(pert);
+        return (flag == EXIT_SUCCESS) ? 0 : -1;
+    }
+    // Find the formulas of an index that match a query, without parsing them again
+    else if (strcmp(opt, "-query") == 0) {
+        char err[CHEM_ERROR_SIZE];
+        long records, matches;
+
+        if (argc < 6) {
+            printf("Usage: %s -query <index_file> <query> <output_file> (such as \"N,S,!metal\" or \"O>=3\")\n", argv[0]);
+            return -1;
+        }
+        bool toStdout = (strcmp(argv[5], "-") == 0);
+        FILE *out = toStdout ? stdout : fopen(argv[5], "w");
+        if (out == NULL) {
+            perror("Unable to open output file\n");
+            exit(-1);
+        }
+        console = toStdout ? stderr : stdout;
+        WRITER *res = fdWriter(fileno(out), bufSize);
+        if (res == NULL) {
+            perror("Memory allocation failed");
+            exit(-1);
+        }
+
+        int status = queryIndex(argv[3], argv[4], res, &records, &matches, err);
+        if (status == EXIT_FAILURE) {
+            perror("Unable to open index file");
+            exit(-1);
+        } else if (status != EXIT_SUCCESS) {
+            fprintf(stderr, "Invalid query or index: %s\n", err);
+            exit(-1);
+        }
+        if (closeWriter(res) == EXIT_FAILURE) {
+            perror("Unable to write output file");
+        }
+        fprintf(console, "%ld of %ld formulas match %s\n", matches, records, argv[4]);
+        if (!toStdout) {
+            fclose(out);
+        }
+        return 0;
     }
     // Check if the option is to compute the extended version of formulas
-    else if (strcmp(opt, "-ext") == 0) {
-        FILE *in, *out;
-        in = fopen(argv[3], "r"); // Open the input file for reading
+    else if (strcmp(opt, "-ext") == 0 || strcmp(opt, "-pn") == 0 || strcmp(opt, "-mass") == 0 || strcmp(opt, "-props") == 0 || strcmp(opt, "-agg") == 0 ||
+             strcmp(opt, "-index") == 0) {
+        if (argc < 5) {
+            printf("Usage: %s [table] %s <input_file> <output_file> [-j <jobs>] [-b <bytes>] [--cache <entries>] [--memo <groups>] [--compact runs|hill] [--stream] [--budget <bytes>] [--over-budget reject|runs|hill] [--checkpoint <seconds>] [--resume] [--stats]\n", argv[0],
+                   (strcmp(opt, "-props") == 0) ? "-props <list>" : opt);
+            return -1;
+        }
+
+        READER *in;
+        FILE *out;
+        in = openReader(argv[3]); // Open the input file for reading
         if (in == NULL) {
             perror("Unable to open input file\n");
             exit(-1); // Exit if the file cannot be opened
         }
 
-        out = fopen(argv[4], "w"); // Open the output file for writing
+        // Open the output file for writing; with the results on stdout the messages go to stderr
+        bool toStdout = (strcmp(argv[4], "-") == 0);
+        if (toStdout) {
+            console = stderr;
+        }
+
+        // The checkpoints go next to the output file, which a resumed run continues
+        char ckpt[strlen(argv[4]) + 6];
+        sprintf(ckpt, "%s.ckpt", argv[4]);
+        if (resume || batch.interval > 0) {
+            if (toStdout || strcmp(opt, "-agg") == 0) {
+                fprintf(stderr, "Checkpoints need the results in an output file\n");
+                exit(-1);
+            }
+            batch.checkpoint = ckpt;
+            if (batch.interval == 0) {
+                batch.interval = CHECKPOINT_SECONDS;
+            }
+            describeMode(batch.start.mode, opt, list, extend, &batch.budget, argv[1]);
+        }
+        if (resume) {
+            CHECKPOINT saved;
+            int found = loadCheckpoint(ckpt, &saved);
+            if (found < 0) {
+                fprintf(stderr, "Unable to read checkpoint %s: %s\n", ckpt, strerror(errno));
+                exit(-1);
+            }
+            if (found == 0) {
+                fprintf(console, "No checkpoint in %s, starting from the beginning\n", ckpt);
+            } else if (strcmp(saved.mode, batch.start.mode) != 0) {
+                fprintf(stderr, "The checkpoint %s was saved by a run with %s, not %s\n", ckpt, saved.mode, batch.start.mode);
+                exit(-1);
+            } else if (skipInput(in, saved.input) == EXIT_FAILURE) {
+                fprintf(stderr, "The input file is shorter than the checkpoint %s\n", ckpt);
+                exit(-1);
+            } else {
+                batch.start = saved;
+                fprintf(console, "Resume from line %d of %s\n", saved.line, fileName(argv[3], "standard input"));
+            }
+        }
+
+        out = toStdout ? stdout : fopen(argv[4], (batch.start.output > 0) ? "r+" : "w");
         if (out == NULL) {
             perror("Unable to open output file\n");
-            fclose(in); // Close the input file if output file fails to open
+            closeReader(in); // Close the input file if output file fails to open
             exit(-1);
         }
-          char *chem,*ext; 
-        chem=(char *)malloc (SIZE*sizeof(char)); // Allocate memory for the chemical formula
-    if (chem == NULL) {
-        perror("Memory allocation failed");
-        fclose(in);
-        fclose(out);
-        exit(-1);
-    }
-        ext=(char *)malloc (SIZE*sizeof(char)); // Allocate memory for the extened chemical formula
-          if (ext == NULL) {
-        perror("Memory allocation failed");
-        fclose(in);
-        fclose(out);
-        exit(-1);
-    }
-        int flag, line = 1;
-        int size=SIZE;
-        printf("Compute extended version of formulas in %s\n", argv[3]);
-        // Process each formula in the input file
-        while (fscanf(in, "%s", chem) != EOF) {
-           if (sizeof(chem) >= size) {  // check if we need more memory space
-            size *= 2;  // Increase size 
-            char *temp = realloc(chem, size);
-            if (temp == NULL) {
-                fprintf(stderr, "Memory reallocation failed\n");
-                free(chem);
-                fclose(in);
-                 fclose(out);
+        if (batch.start.output > 0) {
+            // Drop the results written after the checkpoint, and continue from there
+            off_t size = lseek(fileno(out), 0, SEEK_END);
+            if (size < (off_t)batch.start.output || ftruncate(fileno(out), batch.start.output) < 0 ||
+                lseek(fileno(out), batch.start.output, SEEK_SET) < 0) {
+                fprintf(stderr, "The output file is shorter than the checkpoint %s\n", ckpt);
                 exit(-1);
             }
-            chem = temp;
         }
-           ext = "";  // expanded formula
 
-            flag = extenedChem(chem, ext); // Expand the formula
+        // Results go straight to the file descriptor in big writes
+        WRITER *res = fdWriter(fileno(out), bufSize);
+        WRITER *msg = fileWriter(console, bufSize);
+        if (res == NULL || msg == NULL) {
+            perror("Memory allocation failed");
+            exit(-1);
+        }
 
-            // Check for errors or write expanded formula to output
-            if (flag == EXIT_FAILURE) {
-                printf("Parentheses are NOT balanced in line: %d", line);
-                printf(" -- Failed to compute extended version\n");
-        
-                fprintf(out, "Parentheses are NOT balanced: %s\n", chem);
-            } else {
-                fprintf(out, "%s\n", ext); // Write the expanded formula to the output file
+        if (strcmp(opt, "-ext") == 0) {
+            if (extend == ATOMS) {
+                batch.jobs = 1;      // The workers and the cache would hold whole expansions
+                batch.cacheSize = 0;
             }
-            line++; // Increment line number
+            fprintf(console, "Compute extended version of formulas in %s\n", fileName(argv[3], "standard input"));
+            processFile(extend, in, res, msg, NULL, &batch);
+            flushWriter(msg);
+            writeTime = msg->seconds;
+            closeWriter(msg);
+            phase = (extend == RUNS) ? "compactChem" : (extend == HILL) ? "hillChem" : (extend == ATOMS) ? "atomsChem" : "extenedChem";
+            fprintf(console, "Writing formulas to %s\n", fileName(argv[4], "standard output"));
         }
-        printf("Writing formulas to %s\n", argv[4]);
+        // Add up the element counts of the whole file into one summary
+        else if (strcmp(opt, "-agg") == 0) {
+            const PTABLE *pert = loadTable(argv[1]); // The table file, or the built-in table
 
-        free(chem); // Free memory for the chemical formula
-        fclose(in); // Close the input file
-        fclose(out); // Close the output file
-    }
-    // Check if the option is to compute the total proton number(atomic number)
-    else if (strcmp(opt, "-pn") == 0) {
+            batch.agg = createAggregate(); // Every worker merges its totals into it
+            if (batch.agg == NULL) {
+                perror("Memory allocation failed");
+                exit(-1);
+            }
+            batch.cacheSize = 0; // There are no results to cache
+            fprintf(console, "Compute the element totals of the formulas in %s\n", fileName(argv[3], "standard input"));
+            processFile(SUMMARY, in, NULL, msg, pert, &batch);
+            flushWriter(msg);
+            writeTime = msg->seconds;
+            closeWriter(msg);
+            writeAggregate(res, batch.agg, pert);
+            phase = "countChem";
+            fprintf(console, "Writing the summary in %s \n", fileName(argv[4], "standard output"));
 
-    
-        FILE *in, *out;
-        in = fopen(argv[3], "r"); // Open the input file for reading
-        if (in == NULL) {
-            perror("Unable to open input file\n");
-            exit(-1); // Exit if the file cannot be opened
+            free(batch.agg);
+            freeTable(pert); // Free periodic table memory
         }
+        // Write the elements present in every formula and their atoms into an index file
+        else if (strcmp(opt, "-index") == 0) {
+            const PTABLE *pert = loadTable(argv[1]); // The table file, or the built-in table
 
-        out = fopen(argv[4], "w"); // Open the output file for writing
-        if (out == NULL) {
-            perror("Unable to open output file\n");
-            fclose(in);
-            exit(-1); // Exit if the output file cannot be opened
-        } 
-        
-         PTABLE *pert = (PTABLE *) malloc(sizeof(PTABLE)); // Allocate memory for PTABLE
-    if (pert == NULL) {
-        perror("Memory allocation for periodic table failed.");
-        fclose(in);
-        fclose(out);
-        exit(-1);
-    }
-        createTable(&pert, argv); // Create the periodic table from provided arguments
+            batch.cacheSize = 0; // The records are written without going through the cache
+            fprintf(console, "Index the elements of the formulas in %s\n", fileName(argv[3], "standard input"));
+            if (batch.start.output == 0) {
+                writeIndexHeader(res, pert); // A resumed run continues after it
+            }
+            processFile(INDEX, in, res, msg, pert, &batch);
+            flushWriter(msg);
+            writeTime = msg->seconds;
+            closeWriter(msg);
+            phase = "countChem";
+            fprintf(console, "Writing the index in %s \n", fileName(argv[4], "standard output"));
 
-        int size=SIZE;
-         char *chem,*ext; 
-        chem=(char *)malloc (SIZE*sizeof(char)); // Allocate memory for the chemical formula
-    if (chem == NULL) {
-        perror("Memory allocation failed");
-        fclose(in);
-        fclose(out);
-        exit(-1);
-    }
-        ext=(char *)malloc (SIZE*sizeof(char)); // Allocate memory for the extened chemical formula
-          if (ext == NULL) {
-        perror("Memory allocation failed");
-        fclose(in);
-        fclose(out);
-        exit(-1);
-    }
-        int atnum; // Variable to store the atomic number
-        printf("Compute total proton number (atomic number) of formulas in %s\n", argv[3]);
+            freeTable(pert); // Free periodic table memory
+        }
+        // Compute the properties of the formulas (molar mass, ...) in one parse each
+        else if (batch.props.count > 0) {
+            const PTABLE *pert = loadTable(argv[1]); // The table file, or the built-in table
 
-        // Process each formula in the input file
-   while (fscanf(in, "%s", chem) != EOF) {
-        if (sizeof(chem) >= size) {  // check if we need more memory space
-            size *= 2;  // Increase size 
-            char *temp = realloc(chem, size);
-            if (temp == NULL) {
-                fprintf(stderr, "Memory reallocation failed\n");
-                free(chem);
-                fclose(in);
-                 fclose(out);
-                exit(-1);
-            }
-            chem = temp;
+            fprintf(console, "Compute %s of formulas in %s\n", (batch.props.count == 1 && batch.props.list[0] == PROP_MASS) ? "molar mass" : "properties",
+                    fileName(argv[3], "standard input"));
+            processFile(PROPERTIES, in, res, msg, pert, &batch);
+            flushWriter(msg);
+            writeTime = msg->seconds;
+            closeWriter(msg);
+            phase = "propsChem";
+            fprintf(console, "Writing formulas properties in %s \n", fileName(argv[4], "standard output"));
+
+            freeTable(pert); // Free periodic table memory
+        }
+        // Compute the total proton number(atomic number)
+        else {
+            const PTABLE *pert = loadTable(argv[1]); // The table file, or the built-in table
+
+            fprintf(console, "Compute total proton number (atomic number) of formulas in %s\n", fileName(argv[3], "standard input"));
+            processFile(PROTON, in, res, msg, pert, &batch); // The table is shared read-only by the workers
+            flushWriter(msg);
+            writeTime = msg->seconds;
+            closeWriter(msg);
+            phase = "protonChem";
+            fprintf(console, "Writing formulas atomic numbers in %s \n", fileName(argv[4], "standard output"));
+
+            freeTable(pert); // Free periodic table memory
+        }
+
+        flushWriter(res);
+        writeTime += res->seconds;
+        bytesOut = res->total;
+        bytesIn = in->total;
+        if (closeWriter(res) == EXIT_FAILURE) {
+            perror("Unable to write output file");
+        } else if (batch.checkpoint != NULL) {
+            remove(ckpt); // The run is complete
+        }
+        closeReader(in); // Close the input file
+        if (!toStdout) {
+            fclose(out); // Close the output file
         }
-    ext = "";  // expanded formula
-    if (extenedChem(chem, ext) == EXIT_SUCCESS) {
-        atnum = 0; // Reset total atomic number
-        atomicNum(ext, &atnum, pert,out); // Calculate atomic number
-        fprintf(out, "%d\n", atnum); // Write result to output file
-    } else {
-        fprintf(out, "Error processing formula: %s\n", chem);
     }
 
-}
-    
-    printf("Writing formulas atomic numbers in %s \n", argv[4]);
-       
-         // Clean up resources
-      // Free allocated memory
-    for (int i = 0; i < N; i++) {
-        free(pert->ch[i]);
+    // Report how well the result cache worked
+    if (batch.cacheSize > 0) {
+        fprintf(console, "Result cache: %ld hits, %ld misses, %ld evictions\n", batch.hits, batch.misses, batch.evictions);
+    }
+    if (batch.stats && phase != NULL) {
+        fflush(console);
+        printStats(stderr, phase, &batch, bytesIn, bytesOut, writeTime);
     }
-    free(chem); // Free memory for the chemical formula
-    free(ext); // Free memory for the extened chemical formula
-    free(pert); // Free periodic table memory
-    fclose(in);
-    fclose(out);
-
-     
-    }   
     return 0;
 }
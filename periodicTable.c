@@ -1,53 +1,158 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include "periodicTable.h"
 
 /**
- * @brief Creates and initializes the periodic table from a file.
- * 
- * This function allocates memory for the `PTABLE` structure and reads
- * element data from a file specified in the command line arguments.
- * The file should contain element symbols and their atomic numbers.
+ * @brief Describes an invalid line of a periodic table file and releases what was loaded.
  *
- * @param pert Pointer to the pointer of the `PTABLE` structure to be initialized.
- * @param argv Command line arguments where `argv[1]` is the file path.
+ * @return int CHEM_BAD_TABLE.
  */
-void createTable(PTABLE **pert, char *argv[]) {
-  
-    int i = 0;
-    FILE *fp = fopen(argv[1], "r");
+static int badTable(int line, const char *why, FILE *fp, PTABLE *pert, char *err) {
+    if (err != NULL) {
+        snprintf(err, CHEM_ERROR_SIZE, "line %d: %s", line, why);
+    }
+    fclose(fp);
+    free(pert);
+    return CHEM_BAD_TABLE;
+}
+
+/**
+ * @brief Gets the periodic table to use: the built-in one, or one read from a file.
+ *
+ * Without a file the table that is compiled into the program is returned, so
+ * nothing is read or allocated. A table file has one `symbol atomic_number` pair
+ * per line, optionally followed by the mass and the valence electrons (empty lines
+ * are skipped); it is checked line by line and loaded into the same layout, with
+ * its symbol index built on the way. The mass and valence of the built-in element
+ * with the same symbol are used when they are left out. A file with a symbol
+ * that is not one uppercase letter optionally followed by a lowercase one, an
+ * atomic number or mass that is not positive, a symbol that appears twice, or more
+ * than `N` elements is rejected.
+ *
+ * @param path The table file, or NULL for the built-in table.
+ * @param table Receives the table; release it with `freeTable`.
+ * @param err NULL, or a buffer of `CHEM_ERROR_SIZE` bytes that receives the line and the
+ *        reason when the file is rejected.
+ * @return int CHEM_OK, CHEM_NO_TABLE if the file cannot be opened or read (see errno),
+ *         CHEM_BAD_TABLE if it is not valid, or CHEM_NO_MEMORY.
+ */
+int createTable(const char *path, const PTABLE **table, char *err) {
+    if (path == NULL) {
+        *table = &builtinTable;
+        return CHEM_OK;
+    }
 
+    FILE *fp = fopen(path, "r");
     if (fp == NULL) {
-        perror("Unable to open file");
-        exit(-1);
+        return CHEM_NO_TABLE;
     }
- 
-    // Allocate memory for the PTABLE structure
-    *pert = (PTABLE *)malloc(sizeof(PTABLE));
-    if (*pert == NULL) {
-        perror("Memory allocation failed");
+
+    // One block for the whole table; the zeroed index has no symbols
+    PTABLE *pert = (PTABLE *)calloc(1, sizeof(PTABLE));
+    if (pert == NULL) {
         fclose(fp);
-        exit(-1);
+        return CHEM_NO_MEMORY;
     }
-    
-    // Allocate memory for each string in ch array
-    for (i = 0; i < N; i++) {
-        (*pert)->ch[i] = (char *)malloc(3 * sizeof(char));
-        if ((*pert)->ch[i] == NULL) {
-            perror("Memory allocation failed for element name");
-            fclose(fp);
-            free(*pert);
-            exit(-1);
+
+    char buf[64];
+    int i = 0;
+    int line = 0;
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+        line++;
+        if (strchr(buf, '\n') == NULL && !feof(fp)) {
+            return badTable(line, "line too long", fp, pert, err);
+        }
+
+        // The symbol: an uppercase letter and an optional lowercase letter
+        char *p = buf;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\n' || *p == '\r' || *p == '\0')
+            continue; // Empty line
+        if (*p < 'A' || *p > 'Z') {
+            return badTable(line, "the symbol must start with an uppercase letter", fp, pert, err);
+        }
+        int len = (p[1] >= 'a' && p[1] <= 'z') ? 2 : 1;
+        char *sym = p;
+        p += len;
+        if (*p != ' ' && *p != '\t') {
+            return badTable(line, "expected a symbol of one or two letters and an atomic number", fp, pert, err);
+        }
+
+        // The atomic number
+        char *end;
+        long anum = strtol(p, &end, 10);
+        if (end == p || (*end != ' ' && *end != '\t' && *end != '\r' && *end != '\n' && *end != '\0') ||
+            anum < 1 || anum > INT_MAX) {
+            return badTable(line, "the atomic number must be a positive integer", fp, pert, err);
         }
-    }
-  
-    i = 0;
 
-    // Read data from the file
-    while (fscanf(fp, "%s %d", (*pert)->ch[i], &(*pert)->anum[i]) != EOF ) {
+        // The optional mass and valence; the built-in values of the symbol otherwise
+        int known = findElement(&builtinTable, sym, len);
+        p = end;
+        double mass = strtod(p, &end);
+        if (end == p) {
+            mass = (known >= 0) ? builtinTable.prop[PROP_MASS][known] : 0;
+        } else if (!(mass > 0)) {
+            return badTable(line, "the mass must be positive", fp, pert, err);
+        }
+        p = end;
+        double valence;
+        long count = strtol(p, &end, 10);
+        if (end == p) {
+            valence = (known >= 0) ? builtinTable.prop[PROP_VALENCE][known] : 0;
+        } else if ((*end != ' ' && *end != '\t' && *end != '\r' && *end != '\n' && *end != '\0') ||
+                   count < 0 || count > INT_MAX) {
+            return badTable(line, "the valence must be a non-negative integer", fp, pert, err);
+        } else {
+            valence = count;
+        }
+        while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n')
+            end++;
+        if (*end != '\0') {
+            return badTable(line, "unexpected text after the element", fp, pert, err);
+        }
+
+        if (i == N) {
+            return badTable(line, "too many elements", fp, pert, err);
+        }
+        short *slot = &pert->index[sym[0] - 'A'][(len == 2) ? sym[1] - 'a' + 1 : 0];
+        if (*slot != 0) {
+            return badTable(line, "the symbol is already in the table", fp, pert, err);
+        }
+        memcpy(pert->ch[i], sym, len);
+        pert->anum[i] = (int)anum;
+        pert->prop[PROP_MASS][i] = mass;
+        pert->prop[PROP_ANUM][i] = anum;
+        pert->prop[PROP_ELECTRONS][i] = anum; // Neutral atoms
+        pert->prop[PROP_VALENCE][i] = valence;
+        *slot = i + 1;
         i++;
     }
+    if (ferror(fp)) {
+        fclose(fp);
+        free(pert);
+        return CHEM_NO_TABLE;
+    }
+    if (i == 0) {
+        return badTable(line, "no elements", fp, pert, err);
+    }
     fclose(fp);
+    *table = pert;
+    return CHEM_OK;
+}
+
+/**
+ * @brief Releases a table returned by `createTable` (the built-in table is left alone).
+ *
+ * @param pert The table.
+ */
+void freeTable(const PTABLE *pert) {
+    if (pert != &builtinTable) {
+        free((PTABLE *)pert);
+    }
 }
 
 #ifdef DEBUG1
@@ -59,34 +164,29 @@ void createTable(PTABLE **pert, char *argv[]) {
  * with its atomic number.
  *
  * @param argc Argument count.
- * @param argv Argument vector; `argv[1]` should be the filename containing the periodic table data.
+ * @param argv Argument vector; `argv[1]` is an optional periodic table file (the built-in table otherwise).
  * @return Returns 0 on success, -1 on error.
  */
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <filename>\n", argv[0]);
+    const PTABLE *pert;
+    char err[CHEM_ERROR_SIZE];
+    int status = createTable((argc > 1) ? argv[1] : NULL, &pert, err);
+    if (status == CHEM_NO_TABLE) {
+        perror("Unable to open file");
+        return -1;
+    } else if (status != CHEM_OK) {
+        printf("Invalid periodic table %s: %s\n", argv[1], (status == CHEM_BAD_TABLE) ? err : "out of memory");
         return -1;
     }
 
-    PTABLE *pert = (PTABLE *) malloc(sizeof(PTABLE)); // Allocate memory for PTABLE
-    if (pert == NULL) {
-        perror("Memory allocation for periodic table failed.");
-        exit(-1);
-    }
-    createTable(&pert, argv);
-
     // Print out the elements read
     for (int i = 0; i < N; i++) {
-        if (pert->ch[i] != NULL && pert->anum[i] != 0) {
+        if (pert->anum[i] != 0) {
             printf("Element: %s, Atomic number: %d\n", pert->ch[i], pert->anum[i]);
         }
     }
 
-    // Free allocated memory
-    for (int i = 0; i < N; i++) {
-        free(pert->ch[i]);
-    }
-    free(pert);
+    freeTable(pert);
     return 0;
 }
 #endif
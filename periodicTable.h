@@ -1,21 +1,63 @@
 #ifndef PERIODIC_TABLE
 #define PERIODIC_TABLE
 
+#include "chemStatus.h"
+
 #define N 118           ///< Maximum number of elements in the periodic table
 
+/**
+ * @brief The per-element properties that can be added up over a formula.
+ */
+typedef enum {
+    PROP_MASS,          ///< Atomic mass (g/mol)
+    PROP_ANUM,          ///< Atomic number
+    PROP_ELECTRONS,     ///< Electrons of the neutral atom
+    PROP_VALENCE,       ///< Valence electrons
+    PROPS               ///< Number of properties
+} PROPERTY;
+
 /**
  * @brief Structure to hold the periodic table data.
  * 
  * This structure stores chemical element symbols and their corresponding 
  * atomic numbers in an array format. It includes an array for the symbols
  * and another for the atomic numbers.
+ *
+ * The properties are kept as one column of doubles per property (structure of
+ * arrays), so the sum of a property over an element count vector is a dot product
+ * of two contiguous arrays.
  */
 typedef struct {
-    char *ch[N];         ///< Array of strings to hold element symbols
+    char ch[N][3];       ///< Element symbols (null-terminated, at most two letters)
     int anum[N];        ///< Array of integers to hold atomic numbers
+    short index[26][27]; ///< Slot + 1 of each symbol, by first letter and second letter (0 = none); 0 if not in the table
+    double prop[PROPS][N] __attribute__((aligned(16))); ///< Value of every property for each slot
 } PTABLE;
 
+extern const PTABLE builtinTable; ///< The table compiled into the program (elementTable.c)
 
-void createTable(PTABLE **c, char *argv[]);
+int createTable(const char *path, const PTABLE **table, char *err);
+void freeTable(const PTABLE *pert);
+
+/**
+ * @brief Finds the table slot of an element symbol in constant time.
+ *
+ * Only the first two characters of the symbol are used, which is how the
+ * symbols are compared everywhere else in the program.
+ *
+ * @param pert Pointer to the periodic table.
+ * @param sym The start of the element symbol (it does not have to be null-terminated).
+ * @param len The length of the element symbol.
+ * @return int The slot of the element, or -1 if it is not in the table.
+ */
+static inline int findElement(const PTABLE * const pert, const char *sym, int len) {
+    if (len < 1 || sym[0] < 'A' || sym[0] > 'Z')
+        return -1;
+    if (len == 1)
+        return pert->index[sym[0] - 'A'][0] - 1;
+    if (sym[1] < 'a' || sym[1] > 'z')
+        return -1;
+    return pert->index[sym[0] - 'A'][sym[1] - 'a' + 1] - 1;
+}
 
 #endif
@@ -4,13 +4,29 @@
 
 #include "periodicTable.h"
 #include "chemExt.h"
+#include "chemCount.h"
 #include "protonNum.h"
+#include "stack.h"
+
+/**
+ * @brief Reports a run of atoms of a symbol that is not in the periodic table.
+ *
+ * Uses the format of `countChem`: one message, with the atoms when there are several.
+ */
+static void reportUnknown(FILE *out, const char *ch, long long atoms) {
+    if (atoms == 1) {
+        fprintf(out, "Element %s not found in periodic table.\n", ch);
+    } else if (atoms > 1) {
+        fprintf(out, "Element %s not found in periodic table (%lld atoms).\n", ch, atoms);
+    }
+}
 
 /**
  * @brief Calculates the total atomic number for the given extended chemical formula.
  * 
  * This function parses the extended formula string to extract element symbols,
  * searches for them in the provided periodic table, and sums their atomic numbers.
+ * Consecutive atoms of a symbol that is not in the table are reported in one message.
  *
  * @param ext The extended formula as a string containing element symbols.
  * @param atnum Pointer to an integer where the total atomic number will be stored.
@@ -21,9 +37,11 @@ void atomicNum(char *ext, int *atnum, const PTABLE * const pert, FILE *out) {
     int k = 0; 
     int m = 0; 
    
-    char *ch;
-    ch=(char *)malloc(3*sizeof(char)); // Allocate memory for each the chemical type  
-    for (int i = 0; i < strlen(ext); i++) {
+    char ch[3]; // The chemical type
+    char unknown[3] = ""; // The symbol of the current run of unknown atoms
+    long long atoms = 0; // The atoms of that run
+    int length = strlen(ext);
+    for (int i = 0; i < length; i++) {
         
         while (ext[i] == ' ') {
             i++; // Skip spaces
@@ -42,28 +60,303 @@ void atomicNum(char *ext, int *atnum, const PTABLE * const pert, FILE *out) {
   
         m = 0; // Reset periodic table index
 
-        // Search for the symbol in the periodic table
-        while (m < N && strcmp(pert->ch[m], ch) != 0) {
-            m++;
-        }
+        // Look up the symbol in the periodic table index
+        m = findElement(pert, ch, k);
 
         // Add atomic number if the element was found
-        if (m < N) {
+        if (m >= 0) {
             *atnum += pert->anum[m];
+            reportUnknown(out, unknown, atoms);
+            atoms = 0;
+        } else if (atoms > 0 && strcmp(ch, unknown) == 0) {
+            atoms++;
         } else {
-            fprintf(out, "Element %s not found in periodic table.\n", ch);
+            reportUnknown(out, unknown, atoms);
+            strcpy(unknown, ch);
+            atoms = 1;
         }
     }
+    reportUnknown(out, unknown, atoms);
+}
+
+/**
+ * @brief Calculates the total atomic number of a formula through its element count vector.
+ *
+ * This is the slow path of `protonChem`, used when the formula contains a symbol that
+ * is not in the periodic table, so that the error messages are reported per symbol.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param atnum Pointer to an integer where the total atomic number will be stored.
+ * @param pert Pointer to a constant `PTABLE` structure containing periodic table data.
+ * @param memo The compositions of the groups seen so far, or NULL.
+ * @param out The writer that receives the error messages for unknown elements, or NULL.
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if the total does not fit in 64 bits, CHEM_NO_MEMORY, or CHEM_UNKNOWN.
+ */
+static int protonCounts(const char * const chem, int length, long long *atnum, const PTABLE * const pert, GROUPMEMO *memo, WRITER *out) {
+    long long counts[N];
+    long long total = 0, atoms;
+
+    int flag = countChem(chem, length, counts, pert, memo, out, NULL, NULL);
+    if (flag != EXIT_SUCCESS)
+        return flag;
+
+    for (int i = 0; i < N; i++) {
+        if (__builtin_mul_overflow(counts[i], (long long)pert->anum[i], &atoms) ||
+            __builtin_add_overflow(total, atoms, &total))
+            return CHEM_OVERFLOW;
+    }
+    *atnum = total;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Pushes a 64-bit total onto a stack of ints, as two halves.
+ *
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE if the stack could not grow.
+ */
+static int pushTotal(long long total, STACK *s) {
+    if (pushINT((int)(unsigned int)((unsigned long long)total >> 32), s) == EXIT_FAILURE)
+        return EXIT_FAILURE;
+    return pushINT((int)(unsigned int)total, s);
+}
 
-    free(ch); //free memory for each chemical type
+/**
+ * @brief Pops a 64-bit total pushed with `pushTotal`.
+ */
+static long long popTotal(STACK *s) {
+    int high, low;
+    popINT(s, &low);
+    popINT(s, &high);
+    return (long long)(((unsigned long long)(unsigned int)high << 32) | (unsigned int)low);
 }
 
+/**
+ * @brief Calculates the total atomic number of a chemical formula in a single pass.
+ *
+ * The raw formula is read once and the atomic numbers are added up directly: every
+ * '(' saves the running total on a stack and starts a new one for the group, and
+ * every ')' multiplies the group total by the group multiplier and adds it back to
+ * the saved total. No expanded formula is built.
+ *
+ * With a memo, the total of every group body is remembered, and a group whose
+ * body has been seen before (in this formula or an earlier one) is not parsed again.
+ *
+ * The totals are 64-bit and every step is checked for overflow.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param atnum Pointer to an integer where the total atomic number will be stored.
+ * @param pert Pointer to a constant `PTABLE` structure containing periodic table data.
+ * @param memo The compositions of the groups seen so far, or NULL.
+ * @param out The writer that receives the error messages for unknown elements, or NULL.
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if a multiplier or the total does not fit in 64 bits, CHEM_NO_MEMORY,
+ *         or, without a writer, CHEM_UNKNOWN if an element is not in the table.
+ */
+int protonChem(const char * const chem, int length, long long *atnum, const PTABLE * const pert, GROUPMEMO *memo, WRITER *out) {
+    long long sum = 0; // Total of the innermost open group
+    long long outer; // Total of the enclosing group
+    long long count, atoms;
+    int start; // Position of the '(' of the innermost open group
+    int flag = EXIT_SUCCESS;
+
+    // With a memo, find the group bodies first so that repeated ones can be skipped
+    if (memo != NULL && memchr(chem, '(', length) != NULL) {
+        flag = matchGroups(memo, chem, length);
+        if (flag == EXIT_FAILURE)
+            return EXIT_FAILURE; // Unbalanced
+        if (flag != EXIT_SUCCESS)
+            memo = NULL; // Out of memory, parse without the memo
+        flag = EXIT_SUCCESS;
+    } else {
+        memo = NULL;
+    }
+
+    STACK stack;
+    STACK *sums = &stack; // Stack of the totals and positions of the enclosing groups
+    setupStack(sums);
+
+    for (int i = 0; i < length; i++) {
+        char c = chem[i];
+
+        // If character is uppercase, it's the start of a new element
+        if (c >= 'A' && c <= 'Z') {
+            int sym = i;
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+            }
+            int m = findElement(pert, &chem[sym], i - sym + 1);
+            if (m < 0) {
+                flag = -1; // Unknown element, report it through the count vector
+                break;
+            }
+            count = readMultiplier(chem, length, &i);
+            if (count < 0 || __builtin_mul_overflow(count, (long long)pert->anum[m], &atoms) ||
+                __builtin_add_overflow(sum, atoms, &sum)) {
+                flag = CHEM_OVERFLOW;
+                break;
+            }
+        }
+        // Opening parenthesis: save the running total and start the group
+        else if (c == '(') {
+            int end = (memo != NULL) ? memo->match[i] : 0;
+            if (end - i - 1 >= MEMO_MIN_BODY) {
+                const MEMO *e = findMemo(memo, &chem[i + 1], end - i - 1);
+                if (e != NULL) {
+                    memo->hits++;
+                    i = end; // Skip the body, its total is known
+                    count = readMultiplier(chem, length, &i);
+                    if (count < 0 || __builtin_mul_overflow(e->sum, count, &atoms) ||
+                        __builtin_add_overflow(sum, atoms, &sum)) {
+                        flag = CHEM_OVERFLOW;
+                        break;
+                    }
+                    continue;
+                }
+            }
+            if (pushTotal(sum, sums) == EXIT_FAILURE || pushINT(i, sums) == EXIT_FAILURE) {
+                flag = CHEM_NO_MEMORY;
+                break;
+            }
+            sum = 0;
+        }
+        // Closing parenthesis: multiply the group and add it to the enclosing total
+        else if (c == ')') {
+            if (isEmpty(sums)) {
+                flag = EXIT_FAILURE; // No matching '('
+                break;
+            }
+            popINT(sums, &start);
+            outer = popTotal(sums);
+            if (memo != NULL && i - start - 1 >= MEMO_MIN_BODY) {
+                addMemo(memo, &chem[start + 1], i - start - 1, sum, -1);
+            }
+            count = readMultiplier(chem, length, &i);
+            if (count < 0 || __builtin_mul_overflow(sum, count, &atoms) ||
+                __builtin_add_overflow(outer, atoms, &sum)) {
+                flag = CHEM_OVERFLOW;
+                break;
+            }
+        }
+    }
+
+    // If stack is not empty, there are unmatched parentheses
+    if (flag == EXIT_SUCCESS && !isEmpty(sums))
+        flag = EXIT_FAILURE;
+    clearStack(sums);
+
+    if (flag == -1)
+        return protonCounts(chem, length, atnum, pert, memo, out);
+    if (flag == EXIT_SUCCESS)
+        *atnum = sum;
+    return flag;
+}
+
+#ifdef WIDE_TOTALS
+/**
+ * @brief Reads the multiplier that follows position `*i` as a 128-bit integer.
+ *
+ * @return __int128 The multiplier, 1 if no multiplier follows, or -1 if it does not fit in 127 bits.
+ */
+static __int128 wideMultiplier(const char *chem, int length, int *i) {
+    __int128 count = 1;
+
+    if (*i + 1 < length && chem[*i + 1] >= '0' && chem[*i + 1] <= '9') {
+        count = 0;
+        while (*i + 1 < length && chem[*i + 1] >= '0' && chem[*i + 1] <= '9') {
+            int digit = chem[++(*i)] - '0';
+            if (count < 0 || __builtin_mul_overflow(count, 10, &count) || __builtin_add_overflow(count, digit, &count)) {
+                count = -1; // Too large, keep skipping the digits
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Calculates the total atomic number of a formula in 128 bits.
+ *
+ * This is the slow path of `protonChem` for the totals that do not fit in 64 bits.
+ * It works like `protonChem`, without a memo; the totals of the enclosing groups
+ * are kept in an array of __int128, since they do not fit in a STACK.
+ *
+ * @param chem The chemical formula; it does not have to be null-terminated.
+ * @param length The length of the formula.
+ * @param atnum Pointer to an integer where the total atomic number will be stored.
+ * @param pert Pointer to a constant `PTABLE` structure containing periodic table data.
+ * @return int Returns EXIT_SUCCESS on success, EXIT_FAILURE if parentheses are unbalanced,
+ *         CHEM_OVERFLOW if the total does not fit in 128 bits or the formula has an unknown element,
+ *         or CHEM_NO_MEMORY.
+ */
+int protonWide(const char * const chem, int length, __int128 *atnum, const PTABLE * const pert) {
+    __int128 sum = 0; // Total of the innermost open group
+    __int128 count, atoms;
+    __int128 *saved = NULL; // Totals of the enclosing groups
+    int depth = 0, capacity = 0;
+    int flag = EXIT_SUCCESS;
+
+    for (int i = 0; i < length && flag == EXIT_SUCCESS; i++) {
+        char c = chem[i];
+
+        if (c >= 'A' && c <= 'Z') {
+            int sym = i;
+            while (i + 1 < length && chem[i + 1] >= 'a' && chem[i + 1] <= 'z') {
+                i++;
+            }
+            int m = findElement(pert, &chem[sym], i - sym + 1);
+            count = wideMultiplier(chem, length, &i);
+            if (m < 0 || count < 0 || __builtin_mul_overflow(count, (__int128)pert->anum[m], &atoms) ||
+                __builtin_add_overflow(sum, atoms, &sum)) {
+                flag = CHEM_OVERFLOW; // Unknown elements are only reported by the 64-bit path
+            }
+        } else if (c == '(') {
+            if (depth == capacity) {
+                capacity = (capacity == 0) ? STACK_INLINE : 2 * capacity;
+                __int128 *p = (__int128 *)realloc(saved, capacity * sizeof(__int128));
+                if (p == NULL) {
+                    flag = CHEM_NO_MEMORY;
+                    break;
+                }
+                saved = p;
+            }
+            saved[depth++] = sum;
+            sum = 0;
+        } else if (c == ')') {
+            if (depth == 0) {
+                flag = EXIT_FAILURE; // No matching '('
+                break;
+            }
+            count = wideMultiplier(chem, length, &i);
+            if (count < 0 || __builtin_mul_overflow(sum, count, &atoms) ||
+                __builtin_add_overflow(saved[--depth], atoms, &sum)) {
+                flag = CHEM_OVERFLOW;
+            }
+        }
+    }
+
+    // If there are open groups, there are unmatched parentheses
+    if (flag == EXIT_SUCCESS && depth > 0)
+        flag = EXIT_FAILURE;
+    free(saved);
+
+    if (flag == EXIT_SUCCESS)
+        *atnum = sum;
+    return flag;
+}
+#endif
+
 #ifdef DEBUG3
+#include <limits.h>
+#include "reader.h"
+
 /**
  * @brief Main function for testing the atomic number calculation.
  * 
  * This function reads chemical formulas from an input file, expands them,
  * and calculates the total atomic number for each formula using the periodic table.
+ * The buffer for the expanded formula is sized with `extendedSize` before each expansion.
  *
  * @param argc Argument count.
  * @param argv Argument vector; should contain the periodic table file, input file, and output file.
@@ -76,8 +369,9 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    FILE *in, *out;
-    in = fopen(argv[2], "r"); // Open input file
+    READER *in;
+    FILE *out;
+    in = openReader(argv[2]); // Open input file
     if (in == NULL) {
         perror("Unable to open input file\n");
         exit(-1);
@@ -86,48 +380,58 @@ int main(int argc, char *argv[]) {
     out = fopen(argv[3], "w"); // Open output file
     if (out == NULL) {
         perror("Unable to open output file\n");
-        fclose(in);
+        closeReader(in);
         exit(-1);
     }
 
-    PTABLE *pert = (PTABLE *) malloc(sizeof(PTABLE)); // Allocate memory for PTABLE
-    if (pert == NULL) {
-        perror("Memory allocation for periodic table failed.");
-        fclose(in);
+    const PTABLE *pert;
+    if (createTable(argv[1], &pert, NULL) != CHEM_OK) { // Load periodic table data
+        printf("Unable to load the periodic table %s\n", argv[1]);
+        closeReader(in);
         fclose(out);
-        exit(-1);
+        return -1;
     }
-
-    createTable(&pert, argv); // Load periodic table data
     
-     char *chem,*ext; 
-        chem=(char *)malloc (50*sizeof(char)); // Allocate memory for the chemical formula
-        ext=(char *)malloc (50*sizeof(char)); // Allocate memory for the extened chemical formula
+    const char *chem; // The chemical formula
+    size_t len;
+    char *ext = NULL; // The extended chemical formula, grown as needed
+    size_t extSize = 0;
     int atnum;
+    EXTSIZE size;
 
     // Process each formula in the input file
-    while (fscanf(in, "%s", chem) != EOF) {
-        ext= "";  // Buffer for expanded formula
-          
-        if (extenedChem(chem, ext) == EXIT_SUCCESS) {
+    while (nextFormula(in, &chem, &len)) {
+        int flag = (len > INT_MAX) ? CHEM_OVERFLOW : extendedSize(chem, (int)len, &size);
+        if (flag == EXIT_SUCCESS && size.buffer > INT_MAX) {
+            flag = CHEM_OVERFLOW;
+        }
+        if (flag == EXIT_SUCCESS && size.buffer > extSize) {
+            char *temp = (char *)realloc(ext, size.buffer);
+            if (temp == NULL) {
+                flag = CHEM_NO_MEMORY;
+            } else {
+                ext = temp;
+                extSize = size.buffer;
+            }
+        }
+
+        if (flag == EXIT_SUCCESS && extenedChem(chem, (int)len, ext) == EXIT_SUCCESS) {
             // Expand formula successfully
             atnum = 0; // Reset total atomic number
             atomicNum(ext, &atnum, pert, out); // Calculate atomic number
             fprintf(out, "%d\n", atnum); // Write result to output file
         } else {
-            fprintf(out, "Error processing formula: %s\n", chem);
+            fputs("Error processing formula: ", out);
+            fwrite(chem, 1, len, out);
+            fputc('\n', out);
         }
+        releaseFormulas(in);
     }
 
     // Clean up resources
-    // Free allocated memory
-    for (int i = 0; i < N; i++) {
-        free(pert->ch[i]);
-    }
-    free(pert); // Free periodic table memory
-    free(chem); // Free memory for the chemical formula
+    freeTable(pert); // Free periodic table memory
     free(ext); // Free memory for the extened chemical formula
-    fclose(in); 
+    closeReader(in); 
     fclose(out);
 
     return 0;
@@ -2,8 +2,19 @@
 #define PROTON_NUM
 
 #include "periodicTable.h" // Include the periodic table definition
+#include "writer.h"
+#include "groupMemo.h"
 
+// Totals that do not fit in 64 bits are computed again in 128 bits when the compiler
+// supports it (build with -DNO_WIDE_TOTALS to leave this out)
+#if defined(__SIZEOF_INT128__) && !defined(NO_WIDE_TOTALS)
+#define WIDE_TOTALS
+#endif
 
 void atomicNum(char *ext, int *atnum, const PTABLE * const pert, FILE *out);
+int protonChem(const char * const chem, int length, long long *atnum, const PTABLE * const pert, GROUPMEMO *memo, WRITER *out);
+#ifdef WIDE_TOTALS
+int protonWide(const char * const chem, int length, __int128 *atnum, const PTABLE * const pert);
+#endif
 
 #endif // PROTON_NUM
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+
+/**
+ * @brief Checks if a character separates two formulas (like `fscanf("%s")` does).
+ */
+static int isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * @brief Opens an input file for reading formulas.
+ *
+ * Regular files are memory-mapped; other files are read in blocks of `READ_SIZE` bytes.
+ *
+ * @param path The path of the input file, or `-` for the standard input.
+ * @return READER* The reader, or NULL if the file cannot be opened (errno is set).
+ */
+READER *openReader(const char *path) {
+    struct stat st;
+    READER *r = (READER *)calloc(1, sizeof(READER));
+    if (r == NULL) {
+        return NULL;
+    }
+
+    r->fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+    if (r->fd < 0 || fstat(r->fd, &st) < 0) {
+        if (r->fd > STDIN_FILENO) close(r->fd);
+        free(r);
+        return NULL;
+    }
+
+    // Map regular files, so the formulas are never copied (unless the standard input
+    // was redirected from a file that has already been partly read)
+    if (S_ISREG(st.st_mode) && lseek(r->fd, 0, SEEK_CUR) == 0) {
+        if (st.st_size == 0) {
+            r->data = "";
+            r->eof = 1;
+            return r;
+        }
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            r->data = (const char *)map;
+            r->end = st.st_size;
+            r->total = st.st_size;
+            r->eof = 1;
+            return r;
+        }
+    }
+
+    // Fall back to buffered reads
+    r->capacity = READ_SIZE;
+    r->data = (char *)malloc(r->capacity);
+    if (r->data == NULL) {
+        if (r->fd != STDIN_FILENO) close(r->fd);
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+/**
+ * @brief Reads the next block of the input into the buffer.
+ *
+ * The bytes that are no longer held are dropped first, and the buffer is doubled
+ * if it is still full, so it only grows to the size of the data that is held.
+ *
+ * @param r The reader.
+ * @return int 1 if more data was read, 0 at the end of the input or on error.
+ */
+static int refill(READER *r) {
+    char *buf = (char *)r->data;
+
+    if (r->eof) {
+        return 0;
+    }
+    if (r->start > 0) {
+        memmove(buf, buf + r->start, r->end - r->start);
+        r->pos -= r->start;
+        r->end -= r->start;
+        r->start = 0;
+    }
+    if (r->end == r->capacity) {
+        char *temp = (char *)realloc(buf, 2 * r->capacity);
+        if (temp == NULL) {
+            perror("Memory reallocation failed");
+            r->eof = 1;
+            return 0;
+        }
+        r->data = buf = temp;
+        r->capacity *= 2;
+    }
+
+    ssize_t n;
+    do {
+        n = read(r->fd, buf + r->end, r->capacity - r->end);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        r->eof = 1;
+        return 0;
+    }
+    r->end += n;
+    r->total += n;
+    return 1;
+}
+
+/**
+ * @brief Finds the next formula of the input.
+ *
+ * Formulas are separated by white space, like with `fscanf("%s")`. The view is
+ * not null-terminated and stays valid until `releaseFormulas` is called, but in
+ * buffered mode the held data may move; use `heldFormulas` to locate it again.
+ *
+ * @param r The reader.
+ * @param chem Receives a pointer to the first character of the formula.
+ * @param len Receives the length of the formula.
+ * @return int 1 if a formula was found, 0 at the end of the input.
+ */
+int nextFormula(READER *r, const char **chem, size_t *len) {
+    int held = (r->start != r->pos); // Are earlier formulas still in use?
+
+    // Skip the white space before the formula
+    for (;;) {
+        while (r->pos < r->end && isSpace(r->data[r->pos])) {
+            r->pos++;
+        }
+        if (!held) {
+            r->start = r->pos; // Nothing is held, so the white space can be dropped
+        }
+        if (r->pos < r->end) {
+            break;
+        }
+        if (!refill(r)) {
+            return 0;
+        }
+    }
+
+    // Find the end of the formula
+    size_t first = r->pos - r->start; // Offset from the held data, which may move
+    for (;;) {
+        while (r->pos < r->end && !isSpace(r->data[r->pos])) {
+            r->pos++;
+        }
+        if (r->pos < r->end || !refill(r)) {
+            break;
+        }
+    }
+
+    *chem = r->data + r->start + first;
+    *len = r->pos - (r->start + first);
+    return 1;
+}
+
+/**
+ * @brief Returns the first byte of the data held since the last `releaseFormulas`.
+ *
+ * Views returned since then can be located again as offsets from this pointer.
+ */
+const char *heldFormulas(READER *r) {
+    return r->data + r->start;
+}
+
+/**
+ * @brief Tells the reader that the formulas read so far are no longer needed.
+ */
+void releaseFormulas(READER *r) {
+    r->start = r->pos;
+}
+
+/**
+ * @brief Returns the number of bytes of input before the position of the reader.
+ *
+ * Right after a formula, this is the offset of the byte that follows it.
+ */
+size_t readerOffset(const READER *r) {
+    return r->total - (r->end - r->pos);
+}
+
+/**
+ * @brief Moves a reader that has not handed out any formula to byte `offset` of the input.
+ *
+ * A mapped file is simply entered at the offset; other inputs are read and the bytes
+ * before the offset are dropped, so the standard input can be skipped as well.
+ *
+ * @param r The reader.
+ * @param offset The number of bytes to skip.
+ * @return int Returns EXIT_SUCCESS, or EXIT_FAILURE if the input is shorter than `offset`.
+ */
+int skipInput(READER *r, size_t offset) {
+    while (r->total < offset) {
+        r->start = r->pos = r->end; // Drop everything that has been read
+        if (!refill(r)) {
+            return EXIT_FAILURE;
+        }
+    }
+    r->start = r->pos = offset - (r->total - r->end);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Closes the input file (but not the standard input) and releases the reader.
+ */
+void closeReader(READER *r) {
+    if (r == NULL) return;
+    if (r->capacity > 0) {
+        free((char *)r->data);
+    } else if (r->end > 0) {
+        munmap((void *)r->data, r->end);
+    }
+    if (r->fd != STDIN_FILENO) close(r->fd);
+    free(r);
+}
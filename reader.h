@@ -0,0 +1,35 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+
+#define READ_SIZE (1 << 20)  ///< Size of the buffered reads when the input cannot be mapped
+
+/**
+ * @brief Input file that hands out the formulas as (pointer, length) views.
+ *
+ * A regular file is mapped into memory and the views point straight into the
+ * mapping. Anything else (such as a pipe) is read in large blocks into a buffer
+ * that grows when a formula does not fit in it.
+ */
+typedef struct {
+    int fd;                 ///< The input file descriptor
+    const char *data;       ///< The mapped file or the read buffer
+    size_t start;           ///< First byte that is still held (see `releaseFormulas`)
+    size_t pos;             ///< Where the next formula is searched from
+    size_t end;             ///< Number of valid bytes in `data`
+    size_t capacity;        ///< Size of the read buffer (0 when the file is mapped)
+    int eof;                ///< 1 once the whole input has been read
+    size_t total;           ///< Number of bytes of input read (or mapped) so far
+} READER;
+
+
+READER *openReader(const char *path);
+int nextFormula(READER *r, const char **chem, size_t *len);
+const char *heldFormulas(READER *r);
+void releaseFormulas(READER *r);
+size_t readerOffset(const READER *r);
+int skipInput(READER *r, size_t offset);
+void closeReader(READER *r);
+
+#endif // READER_H
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "batch.h"
+
+/**
+ * @brief State of a connection, kept from one request to the next.
+ */
+typedef struct {
+    int fd;                 ///< Where the requests are read from
+    char *buf;              ///< The bytes read from `fd`
+    size_t start;           ///< First byte of `buf` that has not been consumed yet
+    size_t end;             ///< Number of valid bytes in `buf`
+    size_t capacity;        ///< Size of `buf`
+    int eof;                ///< 1 once `fd` has been read to the end
+    const PTABLE *pert;     ///< The periodic table, shared read-only by all connections
+    GROUPMEMO *memo;        ///< Compositions of the group bodies seen so far (NULL if disabled)
+    char *ext;              ///< Buffer for the extended formula
+    size_t extSize;         ///< Size of `ext`
+    WRITER *out;            ///< Output of the current request, kept in memory
+    WRITER *msg;            ///< Messages of the current request, kept in memory
+    WRITER *answer;         ///< The answers, written to the client
+} SESSION;
+
+/**
+ * @brief A connection accepted by `serveSocket`, handed to its thread.
+ */
+typedef struct {
+    int fd;                 ///< The connection
+    const PTABLE *pert;     ///< The periodic table
+    int memoSize;           ///< Group bodies remembered by the connection
+} CLIENT;
+
+/**
+ * @brief Checks if a character separates two formulas, like in the input files.
+ */
+static int isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * @brief Reads more of the requests into the buffer.
+ *
+ * The consumed bytes are dropped first, and the buffer is doubled if it is still
+ * full, so it only grows to the size of the largest request.
+ *
+ * @return int 1 if more data was read, 0 at the end of the input, on error or if memory runs out.
+ */
+static int fillRequests(SESSION *s) {
+    if (s->eof) {
+        return 0;
+    }
+    if (s->start > 0) {
+        memmove(s->buf, s->buf + s->start, s->end - s->start);
+        s->end -= s->start;
+        s->start = 0;
+    }
+    if (s->end == s->capacity) {
+        char *temp = (char *)realloc(s->buf, 2 * s->capacity);
+        if (temp == NULL) {
+            s->eof = 1;
+            return 0;
+        }
+        s->buf = temp;
+        s->capacity *= 2;
+    }
+
+    ssize_t n;
+    do {
+        n = read(s->fd, s->buf + s->end, s->capacity - s->end);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        s->eof = 1;
+        return 0;
+    }
+    s->end += n;
+    return 1;
+}
+
+/**
+ * @brief Reads the header line of the next request.
+ *
+ * @param header Receives the header, null-terminated and without its newline.
+ * @return int 1 if a header was read, 0 at the end of the requests, or -1 if
+ *         the header is too long or the input ends in the middle of it.
+ */
+static int readHeader(SESSION *s, char header[HEADER_SIZE]) {
+    for (;;) {
+        char *nl = memchr(s->buf + s->start, '\n', s->end - s->start);
+        if (nl != NULL) {
+            size_t len = nl - (s->buf + s->start);
+            if (len >= HEADER_SIZE) {
+                return -1;
+            }
+            memcpy(header, s->buf + s->start, len);
+            header[len] = '\0';
+            s->start += len + 1;
+            return 1;
+        }
+        if (s->end - s->start >= HEADER_SIZE) {
+            return -1;
+        }
+        if (!fillRequests(s)) {
+            return (s->end == s->start) ? 0 : -1;
+        }
+    }
+}
+
+/**
+ * @brief Parses the header of a request.
+ *
+ * @param header The header line (it is modified).
+ * @param mode Receives the operation to perform.
+ * @param props Receives the properties of `-mass`/`-props`.
+ * @param bytes Receives the length of the formulas that follow.
+ * @param line Receives the line number of the first formula.
+ * @return const char* NULL if the header is valid, or the reason it is not.
+ */
+static const char *parseHeader(char *header, MODE *mode, PROPLIST *props, size_t *bytes, int *line) {
+    char *save, *end;
+    char *name = strtok_r(header, " \t", &save);
+
+    if (name == NULL) {
+        return "empty request";
+    }
+    if (strcmp(name, "-v") == 0) {
+        *mode = VERIFY;
+    } else if (strcmp(name, "-ext") == 0) {
+        *mode = EXTEND;
+    } else if (strcmp(name, "-pn") == 0) {
+        *mode = PROTON;
+    } else if (strcmp(name, "-mass") == 0) {
+        *mode = PROPERTIES;
+        parseProperties("mass", props);
+    } else if (strcmp(name, "-props") == 0) {
+        *mode = PROPERTIES;
+        char *list = strtok_r(NULL, " \t", &save);
+        if (list == NULL || parseProperties(list, props) == EXIT_FAILURE) {
+            return "invalid properties";
+        }
+    } else {
+        return "unknown mode";
+    }
+
+    char *size = strtok_r(NULL, " \t", &save);
+    if (size == NULL || *size < '0' || *size > '9') {
+        return "missing length";
+    }
+    errno = 0;
+    unsigned long long n = strtoull(size, &end, 10);
+    if (*end != '\0' || errno != 0 || n > INT_MAX) {
+        return "invalid length";
+    }
+    *bytes = n;
+
+    *line = 1;
+    char *first = strtok_r(NULL, " \t", &save);
+    if (first != NULL) {
+        long l = strtol(first, &end, 10);
+        if (*end != '\0' || l < 1 || l > INT_MAX) {
+            return "invalid line number";
+        }
+        *line = (int)l;
+    }
+    if (strtok_r(NULL, " \t", &save) != NULL) {
+        return "too many fields";
+    }
+    return NULL;
+}
+
+/**
+ * @brief Makes sure the next `bytes` bytes of the requests are in the buffer.
+ *
+ * @return int 1 if they are, 0 if the input ends (or memory runs out) before.
+ */
+static int readBody(SESSION *s, size_t bytes) {
+    while (s->end - s->start < bytes) {
+        if (!fillRequests(s)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Processes the formulas of a request and writes its answer.
+ *
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE if memory ran out (the answer is then an error).
+ */
+static int answerRequest(SESSION *s, MODE mode, const PROPLIST *props, const char *body, size_t bytes, int line) {
+    STATS stats = {0};
+    size_t pos = 0;
+
+    s->out->len = 0;
+    s->msg->len = 0;
+    for (;;) {
+        while (pos < bytes && isSpace(body[pos])) {
+            pos++;
+        }
+        if (pos == bytes) {
+            break;
+        }
+        size_t len = 0;
+        while (pos + len < bytes && !isSpace(body[pos + len])) {
+            len++;
+        }
+        if (len > INT_MAX) {
+            writeString(s->out, "Formula too large: "); // The engines index the formulas with ints
+            writeBytes(s->out, body + pos, len);
+            writeChar(s->out, '\n');
+            line++;
+        } else {
+            processFormula(mode, body + pos, (int)len, line++, s->pert, s->memo, props, NULL, &s->ext, &s->extSize, s->out, s->msg, &stats);
+        }
+        pos += len;
+    }
+
+    if (s->out->error || s->msg->error) {
+        writeString(s->answer, "ERR out of memory\n");
+        return EXIT_FAILURE;
+    }
+    writeString(s->answer, "OK ");
+    writeInt(s->answer, s->out->len);
+    writeChar(s->answer, ' ');
+    writeInt(s->answer, s->msg->len);
+    writeChar(s->answer, '\n');
+    writeBytes(s->answer, s->out->buf, s->out->len);
+    writeBytes(s->answer, s->msg->buf, s->msg->len);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Answers the requests read from `inFd` until it ends.
+ *
+ * The answers are buffered while more requests are already waiting, and sent as
+ * soon as the server has caught up with the client, so pipelined requests cost
+ * few writes.
+ *
+ * @param inFd Where the requests are read from.
+ * @param outFd Where the answers are written.
+ * @param pert Pointer to the periodic table.
+ * @param memoSize Number of group bodies remembered (0 disables the memo).
+ * @return int EXIT_SUCCESS at the end of the requests, or EXIT_FAILURE if a request
+ *         was not valid, memory ran out or the answers could not be written.
+ */
+int serveStream(int inFd, int outFd, const PTABLE * const pert, int memoSize) {
+    SESSION s = { .fd = inFd, .capacity = REQUEST_SIZE, .pert = pert };
+    char header[HEADER_SIZE];
+    int flag = EXIT_SUCCESS;
+
+    signal(SIGPIPE, SIG_IGN); // A client that goes away is a write error, not the end of the server
+
+    s.buf = (char *)malloc(s.capacity);
+    s.out = memoryWriter(WRITE_SIZE);
+    s.msg = memoryWriter(WRITE_SIZE);
+    s.answer = fdWriter(outFd, WRITE_SIZE);
+    s.memo = (memoSize > 0) ? createMemo(memoSize) : NULL;
+    if (s.buf == NULL || s.out == NULL || s.msg == NULL || s.answer == NULL || (memoSize > 0 && s.memo == NULL)) {
+        flag = EXIT_FAILURE;
+        if (s.answer != NULL) {
+            writeString(s.answer, "ERR out of memory\n");
+        }
+        goto done;
+    }
+
+    for (;;) {
+        int got = readHeader(&s, header);
+        if (got == 0) {
+            break;
+        }
+
+        MODE mode;
+        PROPLIST props = {0};
+        size_t bytes;
+        int line;
+        const char *why = (got < 0) ? "invalid header" : parseHeader(header, &mode, &props, &bytes, &line);
+        if (why == NULL && !readBody(&s, bytes)) {
+            why = "incomplete request";
+        }
+        if (why != NULL) {
+            writeString(s.answer, "ERR ");
+            writeString(s.answer, why);
+            writeChar(s.answer, '\n');
+            flag = EXIT_FAILURE;
+            break;
+        }
+
+        const char *body = s.buf + s.start;
+        s.start += bytes;
+        if (answerRequest(&s, mode, &props, body, bytes, line) == EXIT_FAILURE) {
+            flag = EXIT_FAILURE;
+            break;
+        }
+
+        // Send the answers once no other request is waiting
+        if (s.start == s.end && flushWriter(s.answer) == EXIT_FAILURE) {
+            flag = EXIT_FAILURE;
+            break;
+        }
+    }
+
+done:
+    if (s.answer != NULL && closeWriter(s.answer) == EXIT_FAILURE) {
+        flag = EXIT_FAILURE;
+    }
+    if (s.out != NULL) closeWriter(s.out);
+    if (s.msg != NULL) closeWriter(s.msg);
+    freeMemo(s.memo);
+    free(s.ext);
+    free(s.buf);
+    return flag;
+}
+
+/**
+ * @brief Thread that serves one connection of `serveSocket`.
+ */
+static void *clientThread(void *arg) {
+    CLIENT *c = (CLIENT *)arg;
+
+    serveStream(c->fd, c->fd, c->pert, c->memoSize);
+    close(c->fd);
+    free(c);
+    return NULL;
+}
+
+/**
+ * @brief Listens on a Unix domain socket and serves every connection on its own thread.
+ *
+ * The connections share the periodic table, read-only; each one has its own buffers
+ * and memo. A socket file left by an earlier run at `path` is replaced.
+ *
+ * @param path The path of the socket.
+ * @param pert Pointer to the periodic table.
+ * @param memoSize Number of group bodies remembered by every connection (0 disables the memo).
+ * @return int EXIT_FAILURE if the socket cannot be set up or accepting fails; it does not return otherwise.
+ */
+int serveSocket(const char *path, const PTABLE * const pert, int memoSize) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, path);
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path); // Left by an earlier run
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("Unable to listen on the socket");
+        if (fd >= 0) close(fd);
+        return EXIT_FAILURE;
+    }
+
+    for (;;) {
+        int conn = accept(fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("Unable to accept a connection");
+            break;
+        }
+
+        pthread_t thread;
+        CLIENT *c = (CLIENT *)malloc(sizeof(CLIENT));
+        if (c == NULL) {
+            close(conn);
+            continue;
+        }
+        c->fd = conn;
+        c->pert = pert;
+        c->memoSize = memoSize;
+        if (pthread_create(&thread, NULL, clientThread, c) != 0) {
+            close(conn);
+            free(c);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    close(fd);
+    return EXIT_FAILURE;
+}
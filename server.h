@@ -0,0 +1,32 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "periodicTable.h" // Include the periodic table definition
+
+#define REQUEST_SIZE (1 << 16)  ///< Initial size of the request buffer of a connection
+#define HEADER_SIZE 256         ///< Longest request header, including the newline
+
+/*
+ * Server mode: the periodic table is loaded once and batches of formulas are
+ * answered over a Unix domain socket, or over stdin/stdout.
+ *
+ * A request is a header line followed by the formulas:
+ *
+ *     <mode> [<list>] <bytes> [<first line>]\n<bytes of formulas>
+ *
+ * where <mode> is -v, -ext, -pn, -mass or -props (followed by its list of
+ * properties), the formulas are separated by white space like in an input file,
+ * and <first line> (1 by default) numbers them in the messages. The answer is
+ *
+ *     OK <output bytes> <message bytes>\n<output><messages>
+ *
+ * where the output is what parseFormula writes to its output file for these
+ * formulas, and the messages are what it writes to the console. A request that
+ * cannot be parsed is answered with `ERR <reason>\n` and ends the connection.
+ * Requests may be pipelined: the answers come back in the order of the requests.
+ */
+
+int serveStream(int inFd, int outFd, const PTABLE * const pert, int memoSize);
+int serveSocket(const char *path, const PTABLE * const pert, int memoSize);
+
+#endif // SERVER_H
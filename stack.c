@@ -1,76 +1,101 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include "stack.h"
 
+// Operation counters of the calling thread (see takeStackCounts)
+static __thread long pushes = 0;
+static __thread long pops = 0;
+static __thread long grows = 0;
+
 /**
- * @brief Pushes a character onto the stack.
+ * @brief Returns the storage that currently holds the entries of the stack.
  * 
- * This function creates a new node for the stack and pushes a character onto the top.
+ * @param s Pointer to the stack.
+ * @return Pointer to the first (bottom) entry.
+ */
+static int *entries(STACK *s) {
+    return (s->heap != NULL) ? s->heap : s->inl;
+}
+
+/**
+ * @brief Makes room for one more entry.
+ * 
+ * The storage is doubled when it is full, so pushing is amortized constant time
+ * and a stack that is reused never allocates again once it has grown.
  * 
- * @param value The character to be pushed onto the stack.
  * @param s Pointer to the stack.
- * @return EXIT_SUCCESS if the push operation was successful, EXIT_FAILURE otherwise.
+ * @return EXIT_SUCCESS if there is room for one more entry, EXIT_FAILURE otherwise.
  */
-int pushCHAR(char value, STACK *s) {
-    NODE *p = NULL; // Pointer for the new node
-    if (s == NULL) { 
-        return EXIT_FAILURE; // Check if stack is NULL
+static int growStack(STACK *s) {
+    if (s->size < s->capacity) {
+        return EXIT_SUCCESS;
     }
-    
-    // Allocate memory for a new node
-    p = (NODE *)malloc(sizeof(NODE));
+
+    int capacity = 2 * s->capacity;
+    int *p = (int *)realloc(s->heap, capacity * sizeof(int));
     if (p == NULL) {
-        printf("System out of memory!\n");
-        return EXIT_FAILURE; // Check for memory allocation failure
+        return EXIT_FAILURE; // Out of memory; the stack is left as it was
+    }
+    grows++;
+    if (s->heap == NULL) {
+        memcpy(p, s->inl, s->size * sizeof(int)); // Move the inline entries to the heap
     }
+    s->heap = p;
+    s->capacity = capacity;
+    return EXIT_SUCCESS;
+}
 
-    p->data = value; // Assign the value to the new node
-    p->next = s->top; // Adjust the next pointer to the current top
-    s->top = p; // Update the top pointer to the new node
-    (s->size)++; // Increment the stack size
-    return EXIT_SUCCESS; // Return success
+/**
+ * @brief Pushes a character onto the stack.
+ * 
+ * This function stores a character on the top of the stack.
+ * 
+ * @param value The character to be pushed onto the stack.
+ * @param s Pointer to the stack.
+ * @return EXIT_SUCCESS if the push operation was successful, EXIT_FAILURE otherwise.
+ */
+int pushCHAR(char value, STACK *s) {
+    return pushINT(value, s);
 }
 
 /**
  * @brief Pushes an integer onto the stack.
  * 
- * This function creates a new node for the stack and pushes an integer onto the top.
+ * This function stores an integer on the top of the stack.
  * 
  * @param value The integer to be pushed onto the stack.
  * @param s Pointer to the stack.
  * @return EXIT_SUCCESS if the push operation was successful, EXIT_FAILURE otherwise.
  */
 int pushINT(int value, STACK *s) {
-    NODE *p = NULL; // Pointer for the new node
     if (s == NULL) { 
         return EXIT_FAILURE; // Check if stack is NULL
     }
-
-    // Allocate memory for a new node
-    p = (NODE *)malloc(sizeof(NODE));
-    if (p == NULL) {
-        printf("System out of memory!\n");
-        return EXIT_FAILURE; // Check for memory allocation failure
+    if (growStack(s) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
     }
 
-    p->data = value; // Assign the value to the new node
-    p->next = s->top; // Adjust the next pointer to the current top
-    s->top = p; // Update the top pointer to the new node
+    entries(s)[s->size] = value; // Store the value on the top
     (s->size)++; // Increment the stack size
+    pushes++;
     return EXIT_SUCCESS; // Return success
 }
 
 /**
- * @brief Gets the top node of the stack.
+ * @brief Gets the top entry of the stack.
  * 
- * This function retrieves the top node of the stack without removing it.
+ * This function retrieves the top entry of the stack without removing it.
  * 
  * @param s Pointer to the stack.
- * @return Pointer to the top node of the stack.
+ * @return Pointer to the top entry of the stack, or NULL if the stack is empty.
  */
-NODE *top(STACK *s) { 
-    return s->top; // Return the top node
+int *top(STACK *s) { 
+    if (s->size == 0) {
+        return NULL;
+    }
+    return &entries(s)[s->size - 1]; // Return the top entry
 }
 
 /**
@@ -82,7 +107,7 @@ NODE *top(STACK *s) {
  * @return true if the stack is empty, false otherwise.
  */
 bool isEmpty(STACK *s) {
-    return ((s->top) == NULL || s->size == 0); // Return true if top is NULL or size is zero
+    return (s->size == 0); // Return true if size is zero
 }
 
 /**
@@ -95,20 +120,14 @@ bool isEmpty(STACK *s) {
  * @return EXIT_SUCCESS if the pop operation was successful, EXIT_FAILURE otherwise.
  */
 int popCHAR(STACK *s, char *retval) {
-    NODE *p = NULL; // Pointer for the node to be popped
-    if (s == NULL || s->size == 0) {
-        printf("Sorry, stack is empty…\n");
-        return EXIT_FAILURE; // Check if stack is NULL or empty
-    }
+    int value;
     if (retval == NULL) {
-        printf("Retval is null");
         return EXIT_FAILURE; // Check if retval is NULL
     }
-    *retval = (s->top)->data; // Get the top value
-    p = s->top; // Remember the top node for freeing
-    s->top = p->next; // Update the top to the next node
-    (s->size)--; // Decrement the stack size
-    free(p); // Free the allocated memory
+    if (popINT(s, &value) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    *retval = (char)value; // Get the top value
     return EXIT_SUCCESS; // Return success
 }
 
@@ -122,23 +141,72 @@ int popCHAR(STACK *s, char *retval) {
  * @return EXIT_SUCCESS if the pop operation was successful, EXIT_FAILURE otherwise.
  */
 int popINT(STACK *s, int *retval) {
-    NODE *p = NULL; // Pointer for the node to be popped
     if (s == NULL || s->size == 0) {
-        printf("Sorry, stack is empty…\n");
         return EXIT_FAILURE; // Check if stack is NULL or empty
     }
     if (retval == NULL) {
-        printf("Retval is null");
         return EXIT_FAILURE; // Check if retval is NULL
     }
-    *retval = (s->top)->data; // Get the top value
-    p = s->top; // Remember the top node for freeing
-    s->top = p->next; // Update the top to the next node
     (s->size)--; // Decrement the stack size
-    free(p); // Free the allocated memory
+    *retval = entries(s)[s->size]; // Get the top value
+    pops++;
     return EXIT_SUCCESS; // Return success
 }
 
+/**
+ * @brief Adds the operation counters of the calling thread to the given totals.
+ * 
+ * The counters are kept per thread, so counting costs one increment and no
+ * locking; they are reset once they have been taken.
+ * 
+ * @param pushed Receives the number of pushes.
+ * @param popped Receives the number of pops.
+ * @param grown Receives the number of times a stack allocated more storage.
+ */
+void takeStackCounts(long *pushed, long *popped, long *grown) {
+    *pushed += pushes;
+    *popped += pops;
+    *grown += grows;
+    pushes = pops = grows = 0;
+}
+
+/**
+ * @brief Initializes a stack owned by the caller.
+ * 
+ * The stack starts on its inline storage, so a stack declared as a local
+ * variable needs no heap memory unless it grows past `STACK_INLINE` entries.
+ * 
+ * @param s Pointer to the stack to initialize.
+ */
+void setupStack(STACK *s) {
+    s->heap = NULL; // No heap storage yet
+    s->size = 0; // Initialize size to 0
+    s->capacity = STACK_INLINE; // The inline storage is in use
+}
+
+/**
+ * @brief Empties the stack so that it can be reused.
+ * 
+ * The storage is kept, so a reused stack does not allocate again.
+ * 
+ * @param s Pointer to the stack.
+ */
+void resetStack(STACK *s) {
+    s->size = 0;
+}
+
+/**
+ * @brief Releases the heap storage of a stack owned by the caller.
+ * 
+ * The stack is left empty and can still be used.
+ * 
+ * @param s Pointer to the stack.
+ */
+void clearStack(STACK *s) {
+    free(s->heap);
+    setupStack(s);
+}
+
 /**
  * @brief Initializes a new stack.
  * 
@@ -149,7 +217,17 @@ int popINT(STACK *s, int *retval) {
 STACK *initStack() {
     STACK *stack = (STACK *)malloc(sizeof(STACK)); // Allocate memory for the stack
     if (stack == NULL) return NULL; // Check for memory allocation failure
-    stack->top = NULL; // Initialize top to NULL
-    stack->size = 0; // Initialize size to 0
+    setupStack(stack);
     return stack; // Return the initialized stack
 }
+
+/**
+ * @brief Releases a stack created with `initStack`.
+ * 
+ * @param s Pointer to the stack (may be NULL).
+ */
+void freeStack(STACK *s) {
+    if (s == NULL) return;
+    free(s->heap);
+    free(s);
+}
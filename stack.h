@@ -4,25 +4,28 @@
 #include <stdbool.h> // Include for using bool
 #include <stdlib.h>  // Include for memory allocation functions
 
-// Define the Node structure for the stack
-typedef struct Node {
-    int data;              // The data held by the node
-    struct Node *next;     // Pointer to the next node in the stack
-} NODE;
+#define STACK_INLINE 32 // Number of entries a stack holds before it needs heap memory
 
-// Define the Stack structure
+// Define the Stack structure: a contiguous array of entries
 typedef struct {
-    NODE *top;  // Pointer to the top node of the stack
-    int size;   // The current size of the stack
+    int *heap;               // Heap storage once the stack outgrows `inl` (NULL until then)
+    int size;                // The current size of the stack
+    int capacity;            // The number of entries that fit in the current storage
+    int inl[STACK_INLINE];   // Inline storage used by small stacks
 } STACK;
 
 // Function prototypes
-STACK *initStack(void);                     // Initializes a new stack and returns a pointer to it
+STACK *initStack(void);                 // Initializes a new heap stack and returns a pointer to it
+void setupStack(STACK *s);              // Initializes a stack owned by the caller, without allocating
+void resetStack(STACK *s);              // Empties the stack but keeps its storage for reuse
+void clearStack(STACK *s);              // Releases the heap storage of a stack owned by the caller
+void freeStack(STACK *s);               // Releases a stack created with initStack
 int pushCHAR(char value, STACK *s);     // Pushes a character value onto the stack
 int pushINT(int value, STACK *s);       // Pushes an integer value onto the stack
 bool isEmpty(STACK *s);                 // Checks if the stack is empty
 int popCHAR(STACK *s, char *retval);    // Pops a character value from the stack and stores it in retval
 int popINT(STACK *s, int *retval);      // Pops an integer value from the stack and stores it in retval
-NODE *top(STACK *s);                    // Returns the top node of the stack
+int *top(STACK *s);                     // Returns the top entry of the stack
+void takeStackCounts(long *pushed, long *popped, long *grown); // Adds up the operation counters of the calling thread
 
 #endif // STACK_H
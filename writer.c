@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#include "writer.h"
+
+/**
+ * @brief Sink that writes to a stdio stream.
+ */
+static size_t fileSink(void *arg, const char *data, size_t len) {
+    return fwrite(data, 1, len, (FILE *)arg);
+}
+
+/**
+ * @brief Sink that writes straight to a file descriptor, bypassing stdio.
+ */
+static size_t fdSink(void *arg, const char *data, size_t len) {
+    int fd = (int)(long)arg;
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+/**
+ * @brief Hands bytes to the sink, counting them and the time spent writing.
+ *
+ * @return int 1 if all the bytes were written, 0 otherwise.
+ */
+static int drain(WRITER *w, const char *data, size_t len) {
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    size_t n = w->sink(w->arg, data, len);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    w->total += n;
+    w->seconds += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    return n == len;
+}
+
+/**
+ * @brief Creates a writer that hands its buffer to `sink` whenever it is full.
+ *
+ * @param capacity The size of the buffer in bytes.
+ * @param sink Where the buffered bytes go, or NULL to keep them in memory.
+ * @param arg The argument passed to the sink.
+ * @return WRITER* The writer, or NULL if memory allocation fails.
+ */
+WRITER *openWriter(size_t capacity, SINK sink, void *arg) {
+    WRITER *w = (WRITER *)malloc(sizeof(WRITER));
+    if (w == NULL) {
+        return NULL;
+    }
+    if (capacity < 64) {
+        capacity = 64;
+    }
+    w->buf = (char *)malloc(capacity);
+    if (w->buf == NULL) {
+        free(w);
+        return NULL;
+    }
+    w->len = 0;
+    w->capacity = capacity;
+    w->sink = sink;
+    w->arg = arg;
+    w->error = 0;
+    w->total = 0;
+    w->seconds = 0;
+    return w;
+}
+
+/**
+ * @brief Creates a writer for a stdio stream (for example stdout).
+ */
+WRITER *fileWriter(FILE *f, size_t capacity) {
+    return openWriter(capacity, fileSink, f);
+}
+
+/**
+ * @brief Creates a writer for a file descriptor.
+ */
+WRITER *fdWriter(int fd, size_t capacity) {
+    return openWriter(capacity, fdSink, (void *)(long)fd);
+}
+
+/**
+ * @brief Creates a writer that keeps everything in memory.
+ */
+WRITER *memoryWriter(size_t capacity) {
+    return openWriter(capacity, NULL, NULL);
+}
+
+/**
+ * @brief Makes room for `len` more bytes, flushing or growing the buffer.
+ *
+ * @return int 1 if the bytes fit in the buffer now, 0 if they should go to the sink directly.
+ */
+static int reserve(WRITER *w, size_t len) {
+    if (w->len + len <= w->capacity) {
+        return 1;
+    }
+    if (w->sink != NULL) {
+        flushWriter(w);
+        return len <= w->capacity;
+    }
+
+    size_t capacity = w->capacity;
+    while (w->len + len > capacity) {
+        capacity *= 2;
+    }
+    char *temp = (char *)realloc(w->buf, capacity);
+    if (temp == NULL) {
+        w->error = 1;
+        return 0;
+    }
+    w->buf = temp;
+    w->capacity = capacity;
+    return 1;
+}
+
+/**
+ * @brief Appends bytes to the writer.
+ */
+void writeBytes(WRITER *w, const char *data, size_t len) {
+    if (reserve(w, len)) {
+        memcpy(w->buf + w->len, data, len);
+        w->len += len;
+    } else if (w->sink != NULL && !drain(w, data, len)) {
+        w->error = 1; // Larger than the whole buffer, write it through
+    }
+}
+
+/**
+ * @brief Appends a null-terminated string to the writer.
+ */
+void writeString(WRITER *w, const char *s) {
+    writeBytes(w, s, strlen(s));
+}
+
+/**
+ * @brief Appends a single character to the writer.
+ */
+void writeChar(WRITER *w, char c) {
+    if (w->len < w->capacity || reserve(w, 1)) {
+        w->buf[w->len++] = c;
+    }
+}
+
+/**
+ * @brief Appends an integer in decimal, without going through printf.
+ */
+void writeInt(WRITER *w, long long value) {
+    char digits[24];
+    int k = sizeof(digits);
+    unsigned long long u = (value < 0) ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    do {
+        digits[--k] = '0' + (u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (value < 0) {
+        digits[--k] = '-';
+    }
+    writeBytes(w, &digits[k], sizeof(digits) - k);
+}
+
+/**
+ * @brief Appends a number in fixed-point notation with the given number of decimals.
+ *
+ * Numbers that fit in 64 bits once scaled are rounded and written as integers,
+ * without going through printf; the others use printf.
+ */
+void writeFixed(WRITER *w, double value, int decimals) {
+    static const double scale[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    char digits[352]; // Enough for any double with up to 20 decimals
+
+    double scaled = (decimals >= 0 && decimals <= 9) ? value * scale[decimals] : NAN;
+    if (fabs(scaled) < 9e18) { // Fits in 64 bits with the rounding (false for NaN)
+        long long units = (long long)((scaled < 0) ? scaled - 0.5 : scaled + 0.5);
+        unsigned long long u = (units < 0) ? 0ULL - (unsigned long long)units : (unsigned long long)units;
+        int k = sizeof(digits);
+        for (int d = 0; d < decimals; d++) {
+            digits[--k] = '0' + (u % 10);
+            u /= 10;
+        }
+        if (decimals > 0) {
+            digits[--k] = '.';
+        }
+        do {
+            digits[--k] = '0' + (u % 10);
+            u /= 10;
+        } while (u != 0);
+        if (units < 0) {
+            digits[--k] = '-';
+        }
+        writeBytes(w, &digits[k], sizeof(digits) - k);
+        return;
+    }
+
+    int len = snprintf(digits, sizeof(digits), "%.*f", decimals, value);
+    if (len >= (int)sizeof(digits)) {
+        len = sizeof(digits) - 1; // Truncated
+    }
+    writeBytes(w, digits, len);
+}
+
+/**
+ * @brief Hands the buffered bytes to the sink.
+ *
+ * An in-memory writer keeps its bytes.
+ *
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE if a write has failed.
+ */
+int flushWriter(WRITER *w) {
+    if (w->sink != NULL && w->len > 0) {
+        if (!drain(w, w->buf, w->len)) {
+            w->error = 1;
+        }
+        w->len = 0;
+    }
+    return w->error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Flushes the writer and releases it (the file itself is not closed).
+ *
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE if a write has failed.
+ */
+int closeWriter(WRITER *w) {
+    if (w == NULL) return EXIT_SUCCESS;
+    int flag = flushWriter(w);
+    free(w->buf);
+    free(w);
+    return flag;
+}
@@ -0,0 +1,50 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define WRITE_SIZE (1 << 20)  ///< Default size of the output buffer
+
+/**
+ * @brief Function that receives the contents of a full buffer.
+ *
+ * @return The number of bytes that were written; less than `len` means an error.
+ */
+typedef size_t (*SINK)(void *arg, const char *data, size_t len);
+
+/**
+ * @brief Buffered output writer.
+ *
+ * Results are appended into a large buffer that is handed to the sink in big
+ * writes. A writer without a sink keeps everything in memory instead, growing
+ * its buffer; its contents are then available in `buf`/`len`.
+ *
+ * The writer counts the bytes it writes and the time spent writing them; this
+ * costs two clock readings per buffer, so it is always on.
+ */
+typedef struct {
+    char *buf;          ///< The buffered bytes
+    size_t len;         ///< Number of bytes in the buffer
+    size_t capacity;    ///< Size of the buffer
+    SINK sink;          ///< Where full buffers go (NULL for an in-memory writer)
+    void *arg;          ///< Argument of the sink
+    int error;          ///< 1 once a write has failed
+    size_t total;       ///< Number of bytes handed to the sink so far
+    double seconds;     ///< Time spent in the sink, in seconds
+} WRITER;
+
+
+WRITER *openWriter(size_t capacity, SINK sink, void *arg);
+WRITER *fileWriter(FILE *f, size_t capacity);
+WRITER *fdWriter(int fd, size_t capacity);
+WRITER *memoryWriter(size_t capacity);
+void writeBytes(WRITER *w, const char *data, size_t len);
+void writeString(WRITER *w, const char *s);
+void writeChar(WRITER *w, char c);
+void writeInt(WRITER *w, long long value);
+void writeFixed(WRITER *w, double value, int decimals);
+int flushWriter(WRITER *w);
+int closeWriter(WRITER *w);
+
+#endif // WRITER_H